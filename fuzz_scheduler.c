@@ -0,0 +1,313 @@
+/**
+ * Differential fuzzing harness for the Scheduling Simulation
+ *
+ * Authors: Ryan Seys and Osazuwa Omigie
+ *
+ * Turns arbitrary bytes into text input data (the format read by parse_file()), simulates the
+ * workload with every scheduling algorithm on the reference engine and on every optimized engine,
+ * and aborts when the traces differ or when a trace breaks the process state machine. Built with
+ * SHARD_BUSY_PERIODS (and a small SHARD_MIN_PROCESSES), sharded runs are checked against the
+ * reference engine too. Inputs in order of arrival are also streamed (see source_open()) and
+ * checked against it. D lines give the workload dependencies, which every trace must respect.
+ * R lines give periodic tasks, released until FUZZ_HORIZON: the reference engine simulates every
+ * hyperperiod, which checks the ones the optimized engine extrapolates.
+ *
+ * libFuzzer: "make fuzz", then "./fuzz_scheduler corpus test_inputs"
+ * AFL:       "make fuzz-afl", then "afl-fuzz -i test_inputs -o findings ./fuzz_scheduler"
+ *
+ * Without libFuzzer the harness simulates each file given on the command line (or stdin) once,
+ * which is also how a crashing input is reproduced.
+ */
+
+#define SCHEDULER_NO_MAIN
+#include "scheduler.c"
+
+#define FUZZ_MAX_PROCESSES 64 //larger workloads are skipped, they only slow fuzzing down
+#define FUZZ_MAX_WORK 10000 //workloads asking for more cpu time in total are skipped
+#define FUZZ_MAX_START 1000000 //workloads with later arrivals are skipped
+#define FUZZ_MAX_EVENTS 100000 //simulations are cut off after this many events (migration penalties larger than
+                               //the cpu bursts keep processes from ever finishing)
+#define FUZZ_HORIZON 1000 //periodic tasks release no job at or after it
+
+/**
+ * Simulates a copy of a workload
+ * @param  workload processes of the workload, in the order parse_file() queues them
+ * @param  edges    dependencies of the workload, as struct dependency
+ * @param  locks    locks and critical sections of the workload
+ * @param  tasks    periodic tasks of the workload, as struct periodic_task
+ * @param  sort     the scheduling algorithm
+ * @param  engine   the engine
+ * @param  sharded  run it with simulation_run(), which may shard it, instead of a move at a time
+ * @return          the trace as an array of TraceEvents
+ */
+GArray * fuzz_run(GQueue * workload, GArray * edges, struct lock_spec * locks, GArray * tasks, int sort, int engine, gboolean sharded) {
+  GQueue * all = g_queue_new();
+  GArray * events;
+  Simulation * sim;
+  GList * l;
+  int t = INITIAL_TIME;
+
+  for(l = workload->head; l != NULL; l = l->next) {
+    Process * p = malloc(sizeof(Process));
+    assert(p != NULL);
+    *p = *(Process *) l->data;
+    g_queue_push_tail(all, p);
+  }
+  sim = simulation_new(topology, all, sort, NULL);
+  if(edges->len > 0) setup_dependencies(sim, edges);
+  if(locks->sections->len > 0) setup_locks(sim, locks);
+  if(tasks->len > 0) setup_periodic(sim, tasks, FUZZ_HORIZON);
+  sim->engine = engine;
+  sim->events = g_array_new(FALSE, FALSE, sizeof(TraceEvent));
+  if(sharded) simulation_run(sim);
+  else while(sim->events->len < FUZZ_MAX_EVENTS && (t = get_next_move(sim, t)) != INVALID_MOVE);
+  if(sim->events->len > FUZZ_MAX_EVENTS) g_array_set_size(sim->events, FUZZ_MAX_EVENTS); //fast-forwards overshoot the cut off
+  events = sim->events;
+  sim->events = NULL;
+  simulation_free(sim);
+  return events;
+}
+
+/**
+ * Simulates an input streamed from its text, recycling the slots of terminated processes
+ * @param  data the input
+ * @param  size size of the input
+ * @param  sort the scheduling algorithm
+ * @return      the trace as an array of TraceEvents, NULL when the input can not be streamed
+ *              to its end
+ */
+GArray * fuzz_stream(const guint8 * data, size_t size, int sort) {
+  GArray * events;
+  Simulation * sim;
+  FILE * fp;
+
+  if((fp = fmemopen((void *) data, size, "r")) == NULL) return NULL;
+  sim = simulation_new(topology, g_queue_new(), sort, NULL);
+  sim->events = g_array_new(FALSE, FALSE, sizeof(TraceEvent));
+  source_open(sim, fp);
+  simulation_run(sim);
+  events = sim->events;
+  sim->events = NULL;
+  if(sim->source->failed) { //stopped early, at an invalid line or at a process arriving out of order
+    g_array_free(events, TRUE);
+    events = NULL;
+  }
+  simulation_free(sim);
+  return events;
+}
+
+/**
+ * Marks whether every process with a pid needs the cpu without ever leaving it for I/O, a lock or
+ * the end of a time slice (a slice ending as the process completes still preempts it)
+ * @param steady pid --> 1 when it does, 2 when it does not
+ * @param pid    pid of the process
+ * @param ok     whether this process does
+ */
+void fuzz_mark_steady(GHashTable * steady, int pid, gboolean ok) {
+  if(!ok || g_hash_table_lookup(steady, GINT_TO_POINTER(pid)) == NULL) {
+    g_hash_table_insert(steady, GINT_TO_POINTER(pid), GINT_TO_POINTER(ok ? 1 : 2));
+  }
+}
+
+/**
+ * Checks that a trace only makes the transitions of the process state machine, in time order,
+ * that no process becomes ready before the processes it depends on terminated, and that no
+ * process is preempted or completes without using the cpu it was just dispatched to
+ * @param workload processes of the workload
+ * @param edges    dependencies of the workload, as struct dependency
+ * @param locks    lock units and critical sections of the workload
+ * @param tasks    periodic tasks of the workload, as struct periodic_task
+ * @param events   the trace
+ */
+void fuzz_check_trace(GQueue * workload, GArray * edges, struct lock_spec * locks, GArray * tasks, GArray * events) {
+  GHashTable * states = g_hash_table_new(g_direct_hash, g_direct_equal); //pid --> state
+  GHashTable * steady = g_hash_table_new(g_direct_hash, g_direct_equal); //pid --> 1 without I/O, locks and time slices, 2 otherwise
+  GHashTable * dispatched = g_hash_table_new(g_direct_hash, g_direct_equal); //pid --> last time it went on a cpu, plus one
+  GList * l;
+  gboolean unique;
+  guint i, j;
+  int state, since;
+
+  for(l = workload->head; l != NULL; l = l->next) {
+    Process * p = l->data;
+    g_hash_table_insert(states, GINT_TO_POINTER(p->pid), GINT_TO_POINTER(NEW_STATE));
+    fuzz_mark_steady(steady, p->pid, p->tmpl->total > 0 && p->tmpl->iofreq == INT_MAX
+      && p->tmpl->rr == INT_MAX && p->tmpl->program == NULL);
+  }
+  for(i = 0; i < locks->sections->len; i++) {
+    fuzz_mark_steady(steady, g_array_index(locks->sections, struct critical_section, i).pid, FALSE);
+  }
+  for(i = 0; i < tasks->len; i++) {
+    struct periodic_task * t = &g_array_index(tasks, struct periodic_task, i);
+    fuzz_mark_steady(steady, t->pid, t->wcet > 0);
+  }
+  unique = g_hash_table_size(states) == g_queue_get_length(workload) && tasks->len == 0; //jobs of a task share its pid
+  for(i = 0; i < events->len; i++) {
+    TraceEvent * e = &g_array_index(events, TraceEvent, i);
+    assert(i == 0 || e->time >= g_array_index(events, TraceEvent, i - 1).time);
+    //completions at a time come before the dispatches, so even a pid shared by the jobs of a task
+    //can not complete at the time it got a cpu unless it had no work. Preemptions can follow a
+    //dispatch that fills the last cpu, so only a process told apart by its pid is checked for them.
+    since = GPOINTER_TO_INT(g_hash_table_lookup(dispatched, GINT_TO_POINTER(e->pid)));
+    if(e->old_state == READY_STATE && e->new_state == RUNNING_STATE) {
+      g_hash_table_insert(dispatched, GINT_TO_POINTER(e->pid), GINT_TO_POINTER(e->time + 1));
+    }
+    assert(!unique || e->old_state != RUNNING_STATE || e->new_state != READY_STATE || since != e->time + 1);
+    assert(e->old_state != RUNNING_STATE || e->new_state != TERMINATED_STATE || since != e->time + 1
+      || GPOINTER_TO_INT(g_hash_table_lookup(steady, GINT_TO_POINTER(e->pid))) != 1);
+    //with duplicate pids the states of the processes can not be told apart
+    if(unique) {
+      state = GPOINTER_TO_INT(g_hash_table_lookup(states, GINT_TO_POINTER(e->pid)));
+      assert(state == e->old_state);
+      assert((e->old_state == NEW_STATE && e->new_state == READY_STATE)
+        || ((e->old_state == NEW_STATE || e->old_state == READY_STATE) && e->new_state == REJECTED_STATE)
+        || (e->old_state == READY_STATE && e->new_state == RUNNING_STATE)
+        || (e->old_state == RUNNING_STATE && e->new_state != RUNNING_STATE && e->new_state != NEW_STATE
+          && e->new_state != REJECTED_STATE)
+        || (e->old_state == WAITING_STATE && e->new_state == READY_STATE)
+        || (e->old_state == BLOCKED_STATE && e->new_state == READY_STATE));
+      for(j = 0; e->old_state == NEW_STATE && e->new_state == READY_STATE && j < edges->len; j++) {
+        struct dependency * d = &g_array_index(edges, struct dependency, j);
+        state = GPOINTER_TO_INT(g_hash_table_lookup(states, GINT_TO_POINTER(d->parent)));
+        assert(d->pid != e->pid || state == 0 || state == TERMINATED_STATE); //0: no such process
+      }
+      g_hash_table_insert(states, GINT_TO_POINTER(e->pid), GINT_TO_POINTER(e->new_state));
+    }
+  }
+  g_hash_table_destroy(states);
+  g_hash_table_destroy(steady);
+  g_hash_table_destroy(dispatched);
+}
+
+/**
+ * Aborts with the first difference between the trace of an engine and the reference trace
+ * @param reference trace of the reference engine
+ * @param events    trace of the engine being checked
+ * @param sort      the scheduling algorithm
+ * @param engine    the engine being checked
+ * @param sharded   the trace comes from a sharded run
+ */
+void fuzz_compare(GArray * reference, GArray * events, int sort, int engine, gboolean sharded) {
+  guint i, n = MIN(reference->len, events->len);
+
+  if(reference->len == events->len && memcmp(reference->data, events->data, n * sizeof(TraceEvent)) == 0) return;
+  for(i = 0; i < n && memcmp(&g_array_index(reference, TraceEvent, i), &g_array_index(events, TraceEvent, i), sizeof(TraceEvent)) == 0; i++);
+  fprintf(stderr, "Engine %d%s diverges from the reference engine with algorithm %d at event %u of %u\n",
+    engine, sharded ? " (sharded)" : "", sort, i, reference->len);
+  if(i < reference->len) {
+    TraceEvent * e = &g_array_index(reference, TraceEvent, i);
+    fprintf(stderr, "  reference: %d\t%d\t%s\t%s\n", e->time, e->pid, get_state_string(e->old_state), get_state_string(e->new_state));
+  }
+  if(i < events->len) {
+    TraceEvent * e = &g_array_index(events, TraceEvent, i);
+    fprintf(stderr, "  engine %d:  %d\t%d\t%s\t%s\n", engine, e->time, e->pid, get_state_string(e->old_state), get_state_string(e->new_state));
+  }
+  abort();
+}
+
+/**
+ * Sets up the simulator before the first input
+ */
+int LLVMFuzzerInitialize(int * argc, char *** argv) {
+  scheduler_init(TOPOLOGY_FILE);
+  return 0;
+}
+
+/**
+ * Simulates one fuzzer input with every scheduling algorithm on every engine
+ * @param  data the input, read as text input data
+ * @param  size size of the input
+ * @return      0 (inputs are never rejected from the corpus)
+ */
+int LLVMFuzzerTestOneInput(const guint8 * data, size_t size) {
+  GQueue * workload;
+  GArray * edges = g_array_new(FALSE, FALSE, sizeof(struct dependency));
+  struct lock_spec locks = { g_array_new(FALSE, FALSE, sizeof(struct lock_units)),
+    g_array_new(FALSE, FALSE, sizeof(struct critical_section)) };
+  GArray * tasks = g_array_new(FALSE, FALSE, sizeof(struct periodic_task));
+  GArray * reference, * events;
+  GList * l;
+  FILE * fp;
+  guint i;
+  int sort, engine, work = 0;
+
+  if(size == 0 || (fp = fmemopen((void *) data, size, "r")) == NULL) {
+    g_array_free(edges, TRUE);
+    g_array_free(locks.units, TRUE);
+    g_array_free(locks.sections, TRUE);
+    g_array_free(tasks, TRUE);
+    return 0;
+  }
+  workload = parse_stream(fp, edges, &locks, tasks);
+  fclose(fp);
+  if(edges->len > 0 || locks.sections->len > 0) g_array_set_size(tasks, 0); //"scheduler run" refuses them together
+
+  for(l = workload->head; l != NULL; l = l->next) {
+    Process * p = l->data;
+    work += MIN(p->tmpl->total, FUZZ_MAX_WORK + 1);
+    if(p->start > FUZZ_MAX_START) work = FUZZ_MAX_WORK + 1;
+  }
+  for(i = 0; i < tasks->len && work <= FUZZ_MAX_WORK; i++) { //the cpu time of every job released
+    struct periodic_task * t = &g_array_index(tasks, struct periodic_task, i);
+    gint64 jobs = t->offset < FUZZ_HORIZON ? (FUZZ_HORIZON - 1 - t->offset) / t->period + 1 : 0;
+    work += MIN(jobs * t->wcet, FUZZ_MAX_WORK + 1);
+  }
+  if(g_queue_get_length(workload) <= FUZZ_MAX_PROCESSES && work <= FUZZ_MAX_WORK) {
+    for(sort = FCFS_SORT; sort <= EDF_SORT; sort++) {
+      reference = fuzz_run(workload, edges, &locks, tasks, sort, ENGINE_REFERENCE, FALSE);
+      fuzz_check_trace(workload, edges, &locks, tasks, reference);
+      for(engine = ENGINE_REFERENCE + 1; engine < NUM_ENGINES; engine++) {
+        events = fuzz_run(workload, edges, &locks, tasks, sort, engine, FALSE);
+        fuzz_compare(reference, events, sort, engine, FALSE);
+        g_array_free(events, TRUE);
+      }
+      //sharded runs go to the end, so only when the reference run did
+      if(SHARD_BUSY_PERIODS && reference->len < FUZZ_MAX_EVENTS) {
+        events = fuzz_run(workload, edges, &locks, tasks, sort, ENGINE, TRUE);
+        fuzz_compare(reference, events, sort, ENGINE, TRUE);
+        g_array_free(events, TRUE);
+      }
+      //gangs need the whole workload, and streamed runs go to the end too
+      if(sort != GANG_SORT && reference->len < FUZZ_MAX_EVENTS && (events = fuzz_stream(data, size, sort)) != NULL) {
+        fuzz_compare(reference, events, sort, ENGINE, FALSE);
+        g_array_free(events, TRUE);
+      }
+      g_array_free(reference, TRUE);
+    }
+  }
+  g_queue_free_full(workload, free);
+  g_array_free(edges, TRUE);
+  g_array_free(locks.units, TRUE);
+  g_array_free(locks.sections, TRUE);
+  g_array_free(tasks, TRUE);
+  return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+/**
+ * Runs the harness once on each file given on the command line, or on stdin (for AFL and for
+ * reproducing crashes)
+ */
+int main(int argc, char ** argv) {
+  GByteArray * input;
+  guint8 buffer[4096];
+  size_t n;
+  FILE * fp;
+  int i;
+
+  LLVMFuzzerInitialize(&argc, &argv);
+  for(i = 1; i < argc || i == 1; i++) {
+    fp = argc > 1 ? fopen(argv[i], "rb") : stdin;
+    if(fp == NULL) {
+      printf("No such file %s\n", argv[i]);
+      return 1;
+    }
+    input = g_byte_array_new();
+    while((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) g_byte_array_append(input, buffer, n);
+    if(fp != stdin) fclose(fp);
+    LLVMFuzzerTestOneInput(input->data, input->len);
+    g_byte_array_free(input, TRUE);
+  }
+  return 0;
+}
+#endif
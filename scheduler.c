@@ -7,6 +7,12 @@
  * Supports SJF (Shortest Job First)
  * Supports SRTF (Shortest Remaining Time First)
  * Supports Round Robin Time Slicing
+ * Supports Gang Scheduling of parallel jobs on multiple cpus
+ * Supports dependencies between jobs (D lines, see parse_dependencies())
+ * Supports mutexes and semaphores with priority inheritance (L and C lines, see parse_locks())
+ * Supports periodic real-time tasks with RM (Rate Monotonic) and EDF (Earliest Deadline First) scheduling (R lines, see parse_periodic())
+ * Supports running as a simulation server on a Unix domain socket
+ * Supports being used as a library (libscheduler.so, see scheduler.h and scheduler.py)
  * Supports I/O Operation Duration/Frequency
  *
  * Accepts a file where each line is a comma separated string.
@@ -22,7 +28,7 @@
  * The above sample file has 5 lines (5 processes), with each process having six
  * (6) values (pid, start time, total cpu time, io frequency (or zero [0]), io duration (or zero [0]), round robin time slice frequency)
  *
- * Three sample files for FCFS, SJF and SRTF are provided. They can be modified for your experimentation.
+ * Four sample files for FCFS, SJF, SRTF and Gang Scheduling are provided. They can be modified for your experimentation.
  * Each sample will be automatically run with their respective algorithms.
  *
  */
@@ -33,6 +39,14 @@
 #include <glib.h>
 #include <assert.h>
 #include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <zlib.h>
+#include "scheduler.h"
 
 //definitions
 
@@ -44,6 +58,8 @@
 #define WAITING_STATE 3
 #define TERMINATED_STATE 4
 #define NEW_STATE 5
+#define REJECTED_STATE 6 //turned away by admission control
+#define BLOCKED_STATE 7 //waiting for a lock
 #define INVALID_MOVE -1
 
 //strings for output files
@@ -52,6 +68,8 @@
 #define NEW_STATE_STR "NEW"
 #define TERMINATED_STATE_STR "TERMINATED"
 #define RUNNING_STATE_STR "RUNNING"
+#define REJECTED_STATE_STR "REJECTED"
+#define BLOCKED_STATE_STR "BLOCKED"
 #define UNKNOWN_STATE_STR "UNKNOWN"
 
 //move codes
@@ -61,641 +79,6036 @@
 #define RUNNING_TO_TERMINATED 3
 #define RUNNING_TO_WAITING 4
 #define READY_TO_RUNNING 2
+#define RUNNING_TO_BLOCKED 7
+#define BLOCKED_TO_READY 8
 
 //sorting algorithms
 #define FCFS_SORT 0
 #define SJF_SORT 1
 #define SRTF_SORT 2
+#define GANG_SORT 3
+#define RM_SORT 4
+#define EDF_SORT 5
 
 //input and output files
 #define FCFS_INPUT "test_inputs/fcfs.txt"
 #define SJF_INPUT "test_inputs/sjf.txt"
 #define SRTF_INPUT "test_inputs/srtf.txt"
+#define GANG_INPUT "test_inputs/gang.txt"
+#define GANG_TOPOLOGY "test_inputs/gang_topology.txt" //machine of the gang sample, whose gangs need several cpus, unless TOPOLOGY_FILE is set ("" for that of the others)
 #define FCFS_OUTPUT "test_results/fcfs_results.txt"
 #define SJF_OUTPUT "test_results/sjf_results.txt"
 #define SRTF_OUTPUT "test_results/srtf_results.txt"
+#define GANG_OUTPUT "test_results/gang_results.txt"
+#define FCFS_TITLE "--- FIRST COME FIRST SERVE SCHEDULING SIMULATION ---\n"
+#define SJF_TITLE "--- SHORTEST JOB FIRST SCHEDULING SIMULATION ---\n"
+#define SRTF_TITLE "--- SHORTEST REMAINING TIME FIRST SCHEDULING SIMULATION ---\n"
+#define GANG_TITLE "--- GANG SCHEDULING SIMULATION ---\n"
+#define RM_TITLE "--- RATE MONOTONIC SCHEDULING SIMULATION ---\n"
+#define EDF_TITLE "--- EARLIEST DEADLINE FIRST SCHEDULING SIMULATION ---\n"
+#define TRACE_HEADER "time\tpid\told state\tnew state\n"
+#define TRACE_FORMAT "%d\t%d\t%s\t\t%s\n" //a state transition in a trace
+
+//overhead costs in simulated time units (override at compile time, e.g. -DCONTEXT_SWITCH_COST=1)
+#ifndef DISPATCH_COST
+#define DISPATCH_COST 0 //scheduler overhead paid on every ready --> running dispatch
+#endif
+#ifndef CONTEXT_SWITCH_COST
+#define CONTEXT_SWITCH_COST 0 //paid when the cpu switches to a different process
+#endif
+#ifndef CACHE_WARMUP_COST
+#define CACHE_WARMUP_COST 0 //paid when the process' cache was evicted by another process
+#endif
+
+//multi-core configuration (override at compile time, e.g. -DNUM_CPUS=4)
+#ifndef NUM_CPUS
+#define NUM_CPUS 1 //number of simulated cpus
+#endif
+#ifndef CPU_AFFINITY
+#define CPU_AFFINITY 1 //dispatch a process to the cpu it last ran on when that cpu is idle
+#endif
+#ifndef MIGRATION_PENALTY
+#define MIGRATION_PENALTY 0 //cpu time added to a process that moves to another cpu with a warm cache
+#endif
+#ifndef CACHE_DECAY_TIME
+#define CACHE_DECAY_TIME 0 //time for a cache left behind to go fully cold (0 = never goes cold)
+#endif
+#define NO_CPU -1
+
+//numa configuration, the topology file replaces NUM_CPUS (e.g. -DTOPOLOGY_FILE='"test_inputs/topology.txt"')
+#ifndef TOPOLOGY_FILE
+#define TOPOLOGY_FILE "" //no topology: NUM_CPUS cpus on a single node with unlimited memory
+#endif
+#ifndef CROSS_NODE_PENALTY
+#define CROSS_NODE_PENALTY MIGRATION_PENALTY //migration penalty when the process moves to another socket
+#endif
+#ifndef REMOTE_MEMORY_PENALTY
+#define REMOTE_MEMORY_PENALTY 0 //percentage a cpu burst is inflated by when running away from its memory
+#endif
+#define NO_NODE -1
+#define MAX_LINE 256
+#define RECORD_FIELDS 9 //columns of a workload record, including the optional ones
+#define RECORD_TEMPLATE -2 //a line of text input data defined a template instead of a process
+#define RECORD_DEPENDENCY -3 //a line of text input data gave the parents of a job instead of a process
+#define RECORD_LOCK -4 //a line of text input data declared a lock or a critical section instead of a process
+#define RECORD_PERIODIC -5 //a line of text input data declared a periodic task instead of a process
+
+//gang scheduling configuration
+#ifndef GANG_BACKFILL
+#define GANG_BACKFILL 1 //let later work use idle cpus while the gang at the head of the ready queue does not fit
+#endif
+#define NO_JOB -1
+
+//simulation server
+#define SERVER_WORKERS 4 //worker threads running simulations when not given on the command line
+#define SERVER_BACKLOG 16 //pending connections the server socket queues up
+#define MAX_NAME 64 //longest workload name
+#ifndef MAX_LOAD_PROCESSES
+#define MAX_LOAD_PROCESSES 10000000 //largest workload a client may LOAD
+#endif
+#define LOAD_RESERVE 4096 //processes reserved up front by a LOAD, the others as they arrive
+
+//replay log
+#ifndef REPLAY_LOG
+#define REPLAY_LOG 0 //also write a replay log of every run, to compare runs with "scheduler check"
+#endif
+#define REPLAY_BLOCK 65536 //events per block of a replay log
+#define REPLAY_MAGIC "SCHEDRPL"
+#define FCFS_REPLAY "test_results/fcfs_replay.log"
+#define SJF_REPLAY "test_results/sjf_replay.log"
+#define SRTF_REPLAY "test_results/srtf_replay.log"
+#define GANG_REPLAY "test_results/gang_replay.log"
+
+//streaming metrics
+#ifndef METRICS_WINDOW
+#define METRICS_WINDOW 0 //simulated time covered by each line of the metrics output (0 = no metrics output)
+#endif
+#define METRICS_BUCKETS 448 //latency histogram buckets, 16 per power of two up to INT_MAX
+#define FCFS_METRICS "test_results/fcfs_metrics.txt"
+#define SJF_METRICS "test_results/sjf_metrics.txt"
+#define SRTF_METRICS "test_results/srtf_metrics.txt"
+#define GANG_METRICS "test_results/gang_metrics.txt"
+
+//compressed traces
+#ifndef TRACE_COMPRESS
+#define TRACE_COMPRESS 0 //write traces as independently compressed blocks with a block index, instead of text
+#endif
+#ifndef TRACE_BLOCK_SIZE
+#define TRACE_BLOCK_SIZE (1 << 20) //uncompressed bytes of trace per block
+#endif
+#define TRACE_WORKERS 4 //threads compressing blocks
+#define TRACE_INDEX_MAGIC "SCHEDTIX"
+
+//time and pid index of text traces
+#ifndef TRACE_INDEX
+#define TRACE_INDEX 0 //write a sparse time and pid index next to each text trace, for trace_query
+#endif
+#define TRACE_INDEX_CHUNK 4096 //bytes of trace per index entry
+#define TRACE_TIME_INDEX_MAGIC "SCHEDTRI"
+#ifndef TRACE_PID_INDEX
+#define TRACE_PID_INDEX 0 //also write the offset of every line of every pid next to each text trace
+#endif
+#define TRACE_PID_INDEX_MAGIC "SCHEDPIX"
+
+//admission control of arrivals
+#define ADMIT_REJECT_NEWEST 0 //an arrival finding the ready queue full is rejected
+#define ADMIT_DROP_OLDEST 1 //an arrival finding the ready queue full takes the place of the process ready the longest
+#ifndef READY_LIMIT
+#define READY_LIMIT 0 //longest ready queue arrivals are admitted to (0 = unbounded)
+#endif
+#ifndef ADMISSION
+#define ADMISSION ADMIT_REJECT_NEWEST //what happens to an arrival finding the ready queue full
+#endif
+#ifndef TOKEN_RATE
+#define TOKEN_RATE 0 //arrivals admitted per 1000 time units by a token bucket (0 = no token bucket)
+#endif
+#ifndef TOKEN_BURST
+#define TOKEN_BURST 1 //arrivals the token bucket admits back to back
+#endif
+
+//locks
+#ifndef PRIORITY_INHERITANCE
+#define PRIORITY_INHERITANCE 0 //the owner of a mutex is scheduled with the best sort key of the processes blocked on it (SJF and SRTF)
+#endif
+#define NO_BOOST INT_MAX //sort key of a process that inherited none
+#define NO_POSITION -1 //ready heap position of a process that is not in it
+
+//engines, every engine must produce the same trace as the reference one (see fuzz_scheduler.c)
+#define ENGINE_REFERENCE 0 //the original engine on sorted GQueues
+#define ENGINE_HEAP 1 //SJF, SRTF, RM and EDF ready queues ordered by a binary heap, pending events kept in timer heaps
+#define NUM_ENGINES 2
+#ifndef ENGINE
+#define ENGINE ENGINE_HEAP //engine simulations run on
+#endif
+#ifndef SRTF_PREEMPT
+#define SRTF_PREEMPT 0 //SRTF takes the cpu of a running process as soon as a process with less remaining time is ready
+#endif
+
+//busy period sharding
+#ifndef SHARD_BUSY_PERIODS
+#define SHARD_BUSY_PERIODS 0 //simulate the independent busy periods of single cpu runs in parallel
+#endif
+#ifndef SHARD_MIN_PROCESSES
+#define SHARD_MIN_PROCESSES 1024 //busy periods are packed into shards of at least this many processes
+#endif
+#define SHARD_WORKERS 4 //threads simulating shards
+
+//fast-forward of the periodic cycles of a process running alone (ENGINE_HEAP only)
+#define FAST_FORWARD_OFF 0
+#define FAST_FORWARD_EXPANDED 1 //every transition of the cycles is written to the trace
+#define FAST_FORWARD_REPEAT 2 //the first cycle is written to the trace, then a REPEAT record for the others
+#ifndef FAST_FORWARD
+#define FAST_FORWARD FAST_FORWARD_OFF
+#endif
+#define FAST_FORWARD_MIN_CYCLES 4 //shorter runs of cycles are simulated a move at a time
+#define TRACE_REPEAT_FORMAT "%d\t%d\tREPEAT\t\t%d lines %d more times every %d\n" //the last lines of the pid repeat
+
+//periodic tasks
+#ifndef PERIODIC_SHORTCUT
+#define PERIODIC_SHORTCUT 1 //simulate until the schedule repeats a hyperperiod, then extrapolate the others (ENGINE_HEAP only)
+#endif
+
+//approximation mode ("scheduler approx")
+#define APPROX_CHECK_PROCESSES 100000 //workloads up to this size are also simulated exactly, to report the error of the estimates
+#define APPROX_UNORDERED 2 //order of a workload whose records do not come in order of arrival
+
+//sampled simulation ("scheduler sample")
+#define SAMPLE_MIN_PROCESSES 256 //busy periods are packed into segments of at least this many processes
+#define SAMPLE_MIN_SEGMENTS 8 //segments simulated before the confidence intervals are trusted
+#ifndef SAMPLE_PRECISION
+#define SAMPLE_PRECISION 0.02 //sampling stops once the confidence intervals are within this fraction of the estimates
+#endif
+#define SAMPLE_Z 1.96 //normal quantile of the confidence level (95%)
+#define SAMPLE_SEED 1 //seed of the random choice of segments
+
+//timers, the pending events of running and waiting processes with ENGINE_HEAP
+#define TIMER_SLICE 0 //time slice runs out
+#define TIMER_IO 1 //process starts I/O
+#define TIMER_TERMINATE 2 //process completes
+#define TIMER_IO_DONE 3 //I/O completes
+#define NUM_TIMERS 4
+#define NO_TIMER -1
+
+/**
+ * Using a double ended Queue
+ * From http://developer.gnome.org/glib/2.34/glib-Double-ended-Queues.html
+*/
+
+/**
+ * A phase of a burst program: count times over, the process runs for cpu units of cpu time and
+ * then does I/O for io units
+ */
+struct burst_phase {
+    int cpu;
+    int io;
+    int count;
+};
+
+/**
+ * The cpu and I/O bursts of a kind of process, run-length encoded as phases, interned so that
+ * processes with the same bursts share one copy of them (see burst_program())
+ *
+ * count: number of phases
+ * phases: the phases, in order, no two neighbours with the same bursts
+ */
+struct burst_program {
+    guint count;
+    struct burst_phase phases[];
+};
+
+/**
+ * The values a process shares with every other process of the same kind, interned so that
+ * repetitive workloads keep one copy of them (see process_template())
+ *
+ * total: total amount of cpu time
+ * iofreq: how many seconds between each io operation
+ * iodur: duration of io operations
+ * rr: round robin frequency
+ * period: time between the releases of the jobs of a periodic task (0 if the process is not one)
+ * deadline: time after its release a job of a periodic task is due by (0 if the process is not one)
+ * program: bursts of the process, in place of iofreq and iodur (NULL for none)
+ */
+struct process_template {
+    int total;
+    int iofreq;
+    int iodur;
+    int rr;
+    int period;
+    int deadline;
+    const struct burst_program * program;
+};
+
+typedef struct process_template ProcessTemplate;
+
+/**
+ * Represents a process to be stored in a Queue
+ *
+ * pid: process id
+ * start: start time
+ * tmpl: total, iofreq, iodur and rr of the process, never changed once interned
+ * gang: the job's gang when gang scheduling (NULL otherwise)
+ * remaining: remaining amount of cpu time to execute
+ * last_start: last time the process was started
+ * last_io_start: last time the process did io
+ * cpu: cpu the process is running on (NO_CPU when not running)
+ * last_cpu: cpu the process last ran on (NO_CPU if it never ran)
+ * last_stop: last time the process left a cpu
+ * node: numa node holding the process' memory (NO_NODE until first touched)
+ * mem: memory used by the process on its node
+ * job: parallel job the process belongs to (NO_JOB if none)
+ * ready_since: last time the process entered the ready queue
+ * wait_time: total time spent in the ready queue
+ * finish: time the process terminated
+ * timer: position of each pending timer of the process in the simulation's timer heaps (NO_TIMER if none)
+ * phase, burst: where the process is in the burst program of its template: the phase, and the
+ *               bursts of it done
+ */
+struct process {
+    int pid;
+    int start;
+    const ProcessTemplate * tmpl;
+    struct gang * gang;
+    int remaining;
+    int last_start;
+    int last_io_start;
+    int cpu;
+    int last_cpu;
+    int last_stop;
+    int node;
+    int mem;
+    int job;
+    int ready_since;
+    int wait_time;
+    int finish;
+    int timer[NUM_TIMERS];
+    guint phase;
+    guint burst;
+};
+
+typedef struct process Process;
+
+/**
+ * Represents the processes of a parallel job that are scheduled together
+ *
+ * job: job id shared by the members
+ * live: members that have not terminated
+ * ready: members in the ready queue
+ * dispatching: members are being put on cpus at the current time
+ */
+struct gang {
+    int job;
+    int live;
+    int ready;
+    gboolean dispatching;
+};
+
+/**
+ * A dependency read from text input data: the processes with pid can not start before the ones
+ * with parent all terminated
+ *
+ * pid: process id of the dependent job
+ * parent: process id of the job it waits for
+ */
+struct dependency {
+    int pid;
+    int parent;
+};
+
+/**
+ * The dependencies of a simulation, as a graph of jobs in compressed sparse row form. A job is
+ * every process with one pid, and it finishes once all of them terminated. A process arriving
+ * while parent jobs of its job have not finished is held back, in the new state, and moves to
+ * the ready queue as soon as the last of them finishes.
+ *
+ * jobs: pid --> job number + 1, for the pids with dependencies
+ * count: number of jobs
+ * edges: number of dependencies between jobs that have processes (the others are ignored)
+ * first: the successors of job j are successors[first[j]] to successors[first[j + 1] - 1]
+ * successors: job numbers
+ * pending: parent jobs of each job that have not finished
+ * live: processes of each job that have not terminated
+ * held: processes of each job held back, chained through their queue elements, latest arrival first
+ * held_count: processes held back
+ * first_start: arrival of the first process of the workload
+ * critical_path: time from the first arrival to the earliest the workload could finish with a
+ *                cpu for every process (the longest chain of arrivals, dependencies and cpu and
+ *                I/O time), G_MAXINT64 if an I/O never completes
+ */
+struct dependencies {
+    GHashTable * jobs;
+    guint count;
+    guint edges;
+    guint * first;
+    guint * successors;
+    guint * pending;
+    guint * live;
+    GList ** held;
+    guint held_count;
+    int first_start;
+    gint64 critical_path;
+};
+
+/**
+ * A lock declared by text input data, "L,<lock>,<units>"
+ *
+ * lock: lock id
+ * units: processes that can hold the lock at the same time (1 for a mutex)
+ */
+struct lock_units {
+    int lock;
+    int units;
+};
+
+/**
+ * A critical section read from text input data, "C,<pid>,<at>,<lock>,<length>"
+ *
+ * pid: process id of the processes running it
+ * at: cpu time of the process when it acquires the lock
+ * lock: lock id
+ * length: cpu time the process runs before releasing the lock
+ */
+struct critical_section {
+    int pid;
+    int at;
+    int lock;
+    int length;
+};
+
+/**
+ * The locks and critical sections read from text input data (see parse_locks())
+ *
+ * units: the L lines, as struct lock_units
+ * sections: the C lines, as struct critical_section
+ */
+struct lock_spec {
+    GArray * units;
+    GArray * sections;
+};
+
+/**
+ * A point of the lock script of a process, where it acquires or releases a lock
+ *
+ * at: cpu time of the process at the point
+ * lock: lock number in the simulation
+ * acquire: index in the script of the point acquiring the lock (the point itself for an acquire)
+ */
+struct lock_point {
+    int at;
+    guint lock;
+    guint acquire;
+};
+
+/**
+ * The sort key of a process blocked on a mutex, in the heap of the keys of its waiters. An entry
+ * goes stale once the process stops waiting or inherits a better key (which adds another entry),
+ * and is only dropped when it comes to the top.
+ *
+ * key: sort key of the process, inherited keys included
+ * wait: wait of the process the key belongs to (struct lock_state's wait when it was added)
+ * state: where the process is in its lock script
+ */
+struct waiter_key {
+    int key;
+    guint wait;
+    struct lock_state * state;
+};
+
+/**
+ * A mutex or counting semaphore of a simulation. Acquiring a lock with no units left blocks the
+ * process in its wait queue, and each release hands the lock to the first process waiting.
+ *
+ * units: units of the lock no process holds
+ * mutex: TRUE if the lock has a single unit
+ * owner: the process holding a mutex (NULL if it is free, always NULL for a semaphore)
+ * waiters: processes blocked on the lock, in the order they blocked
+ * keys: with PRIORITY_INHERITANCE, a heap of the struct waiter_key of the waiters of a mutex, so
+ *       the owner it is handed to inherits the best key of the rest without scanning them
+ */
+struct lock {
+    int units;
+    gboolean mutex;
+    Process * owner;
+    GQueue * waiters;
+    GArray * keys;
+};
+
+/**
+ * Where a process with a lock script is in it
+ *
+ * points: the script, in order of cpu time, shared by the processes with the same pid
+ * count: number of points
+ * cursor: next point to reach
+ * held: locks held
+ * blocked: TRUE while blocked, on the lock of the point at the cursor
+ * blocked_since: time the process last blocked
+ * boost: best sort key inherited from the processes blocked on its mutexes (NO_BOOST for
+ *        none), kept until it holds no lock
+ * wait: counts the times it blocked or its key improved while blocked, to tell stale waiter keys
+ * position: with PRIORITY_INHERITANCE, where its entry is in the ready heap (NO_POSITION if it
+ *           is not there)
+ */
+struct lock_state {
+    const struct lock_point * points;
+    guint count;
+    guint cursor;
+    guint held;
+    gboolean blocked;
+    int blocked_since;
+    int boost;
+    guint wait;
+    int position;
+};
+
+/**
+ * The locks of a simulation and the scripts of its processes
+ *
+ * count, locks: the locks
+ * points: the lock scripts, grouped by pid
+ * states: where each process with a script is in it
+ * scripts: process --> its struct lock_state
+ * acquisitions: locks acquired, right away or after blocking
+ * contended: acquisitions that blocked
+ * blocked_time: time processes spent blocked on locks
+ * longest_queue: most processes blocked on one lock at a time
+ */
+struct locks {
+    guint count;
+    struct lock * locks;
+    struct lock_point * points;
+    struct lock_state * states;
+    GHashTable * scripts;
+    int acquisitions;
+    int contended;
+    long long blocked_time;
+    guint longest_queue;
+};
+
+/**
+ * Represents a simulated cpu (a hardware thread)
+ *
+ * proc: process currently running on the cpu (NULL if idle)
+ * last_proc: last process dispatched on the cpu (NULL if none yet)
+ * node: numa node (socket) the cpu belongs to
+ * core: physical core of the cpu, SMT siblings share the same core on a node
+ */
+struct cpu {
+    Process * proc;
+    Process * last_proc;
+    int node;
+    int core;
+};
+
+/**
+ * Represents a numa node (a socket and its local memory)
+ *
+ * memory: memory attached to the node
+ * used: memory currently held by processes homed on the node
+ */
+struct node {
+    int memory;
+    int used;
+};
+
+/**
+ * Dispatch overhead accounting for a simulation run
+ *
+ * dispatches: number of ready --> running moves
+ * context_switches: dispatches that switched the cpu to a different process
+ * overhead_time: total time the cpu spent on dispatch, switch and cache warmup costs
+ * migrations: dispatches to a cpu other than the one the process last ran on
+ * cross_node_migrations: migrations that also moved the process to another node
+ * migration_time: cpu time added to processes by migration penalties
+ * remote_time: time cpu bursts were inflated by running away from the process' memory
+ * idle_time: cpu time left idle
+ * waste_time: cpu time left idle while processes were waiting in the ready queue
+ * work: total cpu time requested by the processes that arrived
+ * end_time: time of the last executed move
+ * rejected: processes turned away by admission control, on arrival or dropped from the ready queue
+ * rejected_work: cpu time the rejected processes had left
+ *
+ * The counts the hyperperiod shortcut multiplies up are 64 bit, like the idle times.
+ */
+struct overhead_stats {
+    long long dispatches;
+    long long context_switches;
+    int overhead_time;
+    long long migrations;
+    long long cross_node_migrations;
+    long long migration_time;
+    int remote_time;
+    long long work;
+    int end_time;
+    long long idle_time;
+    long long waste_time;
+    int rejected;
+    long long rejected_work;
+};
+
+/**
+ * A periodic task: a job of it is released every period, from its offset on
+ *
+ * pid: process id of its jobs
+ * offset: release time of its first job
+ * period: time between releases
+ * wcet: worst case execution time of a job, the cpu time every job runs for
+ * deadline: time after its release a job is due by
+ * tmpl: template of its jobs
+ * next: release time of the job waiting in the all queue (INT_MAX once the horizon is reached)
+ */
+struct periodic_task {
+    int pid;
+    int offset;
+    int period;
+    int wcet;
+    int deadline;
+    const ProcessTemplate * tmpl;
+    int next;
+};
+
+/**
+ * The periodic tasks of a simulation. Each task keeps its next job in the all queue, and releasing
+ * a job queues the one after it, until the horizon. Once the schedule repeats a hyperperiod, the
+ * hyperperiods left are extrapolated instead of simulated (see periodic_shortcut()).
+ *
+ * count, tasks: the tasks
+ * by_pid: pid --> task number + 1
+ * horizon: no job is released at or after it
+ * hyperperiod: least common multiple of the periods (0 if it is past the horizon)
+ * pending: tasks with a job waiting in the all queue
+ * utilization: sum of the wcet/period of the tasks
+ * released, finished: jobs released and jobs that terminated
+ * misses: jobs that terminated past their deadline
+ * worst_lateness: longest time a job terminated past its deadline
+ * window: hyperperiod window of the mark (-1 for none)
+ * mark: time of the mark
+ * phases: release time of the next job of each task at the mark, relative to the mark
+ * ready: pids of the ready jobs at the mark, in ready queue order
+ * events: transitions since the mark
+ * stats, counts: overhead stats and released, finished and misses at the mark
+ * skipped: hyperperiods extrapolated instead of simulated
+ * skipped_from: time the extrapolated hyperperiods start at
+ */
+struct periodic {
+    guint count;
+    struct periodic_task * tasks;
+    GHashTable * by_pid;
+    int horizon;
+    gint64 hyperperiod;
+    guint pending;
+    double utilization;
+    long long released;
+    long long finished;
+    long long misses;
+    int worst_lateness;
+    gint64 window;
+    int mark;
+    int * phases;
+    GArray * ready;
+    GArray * events;
+    struct overhead_stats stats;
+    long long counts[3];
+    int skipped;
+    int skipped_from;
+};
+
+/**
+ * Cpu sets are bitsets with one bit per cpu, packed into 64 bit words, so that finding and
+ * counting idle cpus costs a few word operations even with thousands of cpus
+ */
+typedef guint64 CpuSet;
+#define CPU_SET_WORDS(n) (((n) + 63) / 64)
+
+/**
+ * The cpus and numa nodes of the simulated machine, shared read-only by all simulations
+ *
+ * num_cpus, cpus: the cpus with their node and core
+ * num_nodes, nodes: the nodes with their memory
+ */
+struct topology {
+    int num_cpus;
+    struct cpu * cpus;
+    int num_nodes;
+    struct node * nodes;
+};
+
+typedef struct topology Topology;
+
+/**
+ * Replay log of a simulation run: a hash chain over every state transition, so that two runs
+ * can be compared without keeping their traces. The log is a header (REPLAY_MAGIC) followed by
+ * blocks of up to REPLAY_BLOCK events. A block holds the number of events, the times of its first
+ * and last event and the chain after its last event, followed by the low 16 bits of the chain
+ * after each of its events. Equal chains mean identical runs; the per event bits find the first
+ * event that differs.
+ *
+ * file: the log
+ * chain: hash of every event so far
+ * events: number of events before the current block
+ * count, first_time, last_time: events of the current block and their times
+ * hashes: low bits of the chain after each event of the current block
+ */
+struct replay {
+    FILE * file;
+    guint64 chain;
+    guint64 events;
+    guint32 count;
+    gint32 first_time;
+    gint32 last_time;
+    guint16 hashes[REPLAY_BLOCK];
+};
+
+/**
+ * Latency histogram with buckets of logarithmically growing width, so that it takes the same
+ * memory however many latencies go in
+ *
+ * count: number of latencies
+ * buckets: latencies per bucket, exact below 16 and within 1/16 above
+ */
+struct histogram {
+    guint count;
+    guint buckets[METRICS_BUCKETS];
+};
+
+/**
+ * Metrics of the current window of a simulation, written out as a line once the simulation
+ * time passes the end of the window
+ *
+ * file: the metrics output
+ * window: simulated time covered by each window
+ * window_start: start of the current window
+ * terminated: processes that terminated in the window
+ * idle_time: cpu time left idle in the window
+ * ready_area: ready queue length integrated over the window
+ * ready_max: longest ready queue in the window
+ * wait: time processes dispatched in the window waited in the ready queue
+ * turnaround: turnaround time of the processes that terminated in the window
+ */
+struct metrics {
+    FILE * file;
+    int window;
+    int window_start;
+    int terminated;
+    long long idle_time;
+    long long ready_area;
+    int ready_max;
+    struct histogram wait;
+    struct histogram turnaround;
+};
+
+/**
+ * A block of a compressed trace
+ *
+ * text: the trace lines of the block
+ * first_time, last_time: times of the first and last transition in the block (-1 for none)
+ * data, size: the block compressed as a gzip member, once done
+ * done: the block has been compressed
+ */
+struct trace_block {
+    GString * text;
+    int first_time;
+    int last_time;
+    guint8 * data;
+    gsize size;
+    gboolean done;
+};
+
+/**
+ * An entry of the block index of a compressed trace, one per block in file order
+ *
+ * first_time, last_time: times of the first and last transition in the block (-1 for none)
+ * offset: position of the block in the compressed trace
+ * size: compressed size of the block
+ * length: uncompressed size of the block
+ */
+struct trace_block_entry {
+    gint32 first_time;
+    gint32 last_time;
+    guint64 offset;
+    guint32 size;
+    guint32 length;
+};
+
+/**
+ * Writes a compressed trace: a series of gzip members, each holding a block of whole lines, so
+ * that the file reads as one gzip file and every block can be decompressed on its own. Full
+ * blocks are compressed by a pool of threads and written out in order, with an entry each in
+ * the block index.
+ *
+ * file, index: the compressed trace and its block index
+ * offset: size of the compressed trace so far
+ * block: the block being filled
+ * pending: blocks handed to the compressor threads, in trace order
+ * pool: the compressor threads
+ * lock, compressed: guard the pending blocks, signalled when a block is done
+ */
+struct trace_writer {
+    FILE * file;
+    FILE * index;
+    guint64 offset;
+    struct trace_block * block;
+    GQueue * pending;
+    GThreadPool * pool;
+    GMutex lock;
+    GCond compressed;
+};
+
+/**
+ * A sparse time and pid index of a text trace. The trace is cut into chunks of whole lines of
+ * about TRACE_INDEX_CHUNK bytes, and the index holds the time range and position of every chunk,
+ * and for every pid the chunks it appears in. Written out when the trace is closed:
+ * TRACE_TIME_INDEX_MAGIC, the number of chunks and of pids (guint32), the chunks, the pid
+ * directory sorted by pid, then the chunk numbers of the pids (guint32)
+ *
+ * filename: name of the trace
+ * file: the index file
+ * offset: position in the trace of the next line
+ * chunks: a struct trace_block_entry for every chunk (size and length are both the chunk's length)
+ * pids: pid --> GArray of the numbers of the chunks the pid appears in
+ * postings: pid --> struct trace_postings (NULL without TRACE_PID_INDEX)
+ */
+struct trace_index {
+    char * filename;
+    FILE * file;
+    guint64 offset;
+    GArray * chunks;
+    GHashTable * pids;
+    GHashTable * postings;
+};
+
+/**
+ * The posting list of a pid: the offsets in the trace of all its lines, in increasing order,
+ * each stored as its distance from the one before (the first from 0) in a varint: 7 bits per
+ * byte, lowest first, the high bit set on all bytes but the last. Written out by pid when the
+ * trace is closed, to the trace name with ".pix" appended: TRACE_PID_INDEX_MAGIC, the number of
+ * pids and of lines (guint32), a directory of struct trace_pid_entry sorted by pid (count is the number of
+ * lines, position where the posting list starts after the directory), then the posting lists
+ *
+ * data: the encoded offsets
+ * last: the last offset
+ * count: number of offsets
+ */
+struct trace_postings {
+    GByteArray * data;
+    guint64 last;
+    guint32 count;
+};
+
+/**
+ * An entry of the pid directory of a trace index
+ *
+ * pid: process id
+ * count: number of chunks the pid appears in
+ * position: where the chunk numbers of the pid start in the chunk numbers of the index
+ */
+struct trace_pid_entry {
+    gint32 pid;
+    guint32 count;
+    guint64 position;
+};
+
+/**
+ * An entry of a heap ordered ready queue. Keys only change while a process runs, so a process'
+ * key is taken once when it becomes ready and the rest of the heap never needs updating.
+ *
+ * key: sort key of the process (total for SJF, remaining for SRTF)
+ * seq: when the process became ready, equal keys keep that order like with a stable sort
+ * link: element of the process in the ready queue
+ * lock: with PRIORITY_INHERITANCE, where the process is in its lock script (NULL without one),
+ *       told where the entry moves so an inherited key can move it up right away
+ */
+struct ready_entry {
+    int key;
+    guint64 seq;
+    GList * link;
+    struct lock_state * lock;
+};
+
+/**
+ * A pending event of a running or waiting process, in the timer heap of its kind. A process
+ * leaving the running queue cancels its other running timers through their positions, so
+ * the heaps only ever hold live events.
+ *
+ * time: when the event happens (INT_MAX for never)
+ * seq: when the process entered its queue, equal times go in queue order like with a scan
+ * p: the process
+ * link: element of the process in the running or waiting queue
+ */
+struct timer {
+    int time;
+    guint64 seq;
+    Process * p;
+    GList * link;
+};
+
+/**
+ * A shard of a workload: consecutive busy periods, simulated on their own
+ *
+ * sim: simulation of the processes of the shard, collecting its transitions
+ * start: arrival of the first process of the shard
+ */
+struct shard {
+    struct simulation * sim;
+    int start;
+};
+
+/**
+ * What the approximation mode knows about a workload, gathered in one pass over its records
+ *
+ * count: number of processes
+ * first_start, last_start: earliest and latest arrival
+ * prev_start: arrival of the previous record
+ * order: 1 or -1 while the records come in ascending or descending order of arrival (0 before
+ *        the first gap), APPROX_UNORDERED once they do not
+ * gaps, gaps2: sum of the gaps between the arrivals of consecutive records, and of their squares
+ * io: total time the processes spend in I/O
+ * sizes, sliced, work, work2: per bucket of cpu time (see histogram_bucket()), the number of
+ *        processes, how many of them run in more than one burst, the sum of their cpu times and
+ *        of their squares
+ */
+struct workload_summary {
+    gint64 count;
+    int first_start;
+    int last_start;
+    int prev_start;
+    int order;
+    double gaps;
+    double gaps2;
+    double io;
+    double sizes[METRICS_BUCKETS];
+    double sliced[METRICS_BUCKETS];
+    double work[METRICS_BUCKETS];
+    double work2[METRICS_BUCKETS];
+};
+
+/**
+ * Estimates of the approximation mode, or the exact values they are checked against
+ *
+ * turnaround: mean time from arrival to termination
+ * wait: mean time spent in the ready queue
+ * makespan: time from the first arrival to the end
+ * utilization: share of the cpu time of the makespan spent on the processes
+ */
+struct approximation {
+    double turnaround;
+    double wait;
+    double makespan;
+    double utilization;
+};
+
+/**
+ * A segment of a sampled workload: consecutive processes, simulated on their own when chosen
+ *
+ * head: first process of the segment, in the workload in order of arrival
+ * count: number of processes
+ * terminated: processes that terminated in the simulation of the segment
+ * turnaround, wait: sums over the processes that terminated
+ * end: time the simulation of the segment ended
+ */
+struct sample_segment {
+    GList * head;
+    guint count;
+    double terminated;
+    double turnaround;
+    double wait;
+    int end;
+};
+
+/**
+ * Text input data read as a streamed run needs it, so that the run only holds the processes
+ * that have arrived and not terminated yet
+ *
+ * file: the text input data, in order of arrival
+ * templates: the templates defined so far by the data (see parse_process())
+ * next: first process of the next arrival time, read ahead (NULL at the end of the data)
+ * last_start: arrival time of the processes moved to the all queue last
+ * failed: whether reading stopped before the end of the data
+ */
+struct process_source {
+    FILE * file;
+    GHashTable * templates;
+    GList * next;
+    int last_start;
+    gboolean failed;
+};
+
+/**
+ * Totals of the summary records of a streamed run
+ *
+ * file: where the summary records go
+ * count: processes that terminated
+ * turnaround, wait: sums over them
+ */
+struct stream_totals {
+    FILE * file;
+    guint64 count;
+    double turnaround;
+    double wait;
+};
+
+/**
+ * Everything a simulation run works on, so that several runs can go on at the same time
+ *
+ * all, ready, running, waiting, terminated: queues named after the different states of the processes
+ * rejected: processes turned away by admission control
+ * source: input the all queue is filled from as the run goes (NULL when it holds the whole workload)
+ * free_slots: processes (and their queue elements) that terminated in a streamed run or a run
+ *             with periodic tasks, chained through next, for reuse by the arrivals read or
+ *             released next
+ * slots: processes allocated by a streamed run
+ * sort: the scheduling algorithm
+ * engine: the engine implementation
+ * ready_heap: order of the ready queue with ENGINE_HEAP, a binary heap of struct ready_entry
+ * ready_seq: number of times processes became ready
+ * timers: timer heaps of each kind with ENGINE_HEAP, binary heaps of struct timer
+ * timer_seq: number of times processes entered the running or waiting queue
+ * tokens: arrivals the token bucket admits, in thousandths (TOKEN_RATE)
+ * tokens_time: time the token bucket was last filled up
+ * trace: file the state transitions are written to (NULL for no trace)
+ * trace_index: time and pid index of the trace (NULL for none)
+ * ztrace: compressed trace the state transitions are written to (NULL for none)
+ * events: array the state transitions are collected in as TraceEvents (NULL for none)
+ * replay: replay log the state transitions are chained into (NULL for none)
+ * metrics: streaming metrics of the run (NULL for none)
+ * stats: overhead accounting of the run
+ * num_cpus, cpus: state of the cpus during the run
+ * num_nodes, nodes: state of the numa nodes during the run
+ * cpu_set_words: number of words in each cpu set
+ * idle_cpus: cpus with no process running
+ * node_cpus: cpus of each node
+ * gangs: job id --> struct gang (only when gang scheduling)
+ * dependencies: dependencies between the jobs of the workload (NULL for none)
+ * locks: locks of the workload and the lock scripts of its processes (NULL for none)
+ * periodic: periodic tasks of the workload (NULL for none)
+ * on_terminate: called with every process that terminates (NULL for none)
+ * data: passed to on_terminate
+ */
+struct simulation {
+    GQueue * all;
+    GQueue * ready;
+    GQueue * running;
+    GQueue * waiting;
+    GQueue * terminated;
+    GQueue * rejected;
+    struct process_source * source;
+    GList * free_slots;
+    guint slots;
+    int sort;
+    int engine;
+    GArray * ready_heap;
+    guint64 ready_seq;
+    GArray * timers[NUM_TIMERS];
+    guint64 timer_seq;
+    gint64 tokens;
+    int tokens_time;
+    FILE * trace;
+    struct trace_index * trace_index;
+    struct trace_writer * ztrace;
+    GArray * events;
+    struct replay * replay;
+    struct metrics * metrics;
+    struct overhead_stats stats;
+    Topology * topology; //machine the simulation was created on, which its shards run on too
+    int num_cpus;
+    struct cpu * cpus;
+    int num_nodes;
+    struct node * nodes;
+    int cpu_set_words;
+    CpuSet * idle_cpus;
+    CpuSet ** node_cpus;
+    GHashTable * gangs;
+    struct dependencies * dependencies;
+    struct locks * locks;
+    struct periodic * periodic;
+    void (*on_terminate)(struct simulation *, Process *, void *);
+    void * data;
+};
+
+typedef struct simulation Simulation;
+
+Topology * topology; //the machine every simulation runs on
+
+/**
+ * FCFS Sorting Algorithm: Compares 2 processes in a queue based on their time of arrival
+ * @param  a    First process
+ * @param  b    Second process
+ * @param  data data (typically NULL in this case)
+ * @return      a negative value if a < b, 0 if a = b, a positive value if a > b
+ */
+gint sort_fcfs(gconstpointer a, gconstpointer b, gpointer data) {
+  Process * ap = (Process *) a;
+  Process * bp = (Process *) b;
+  return ap->start - bp->start; // sort so head is the least start time
+}
+
+/**
+ * Shortest Job First: Compares 2 processes in a queue based on their execution time
+ * @param  a    First process
+ * @param  b    Second process
+ * @param  data unused var
+ * @return      a negative value if a < b, 0 if a = b, a positive value if a > b
+ */
+gint sort_sjf(gconstpointer a, gconstpointer b, gpointer data) {
+  Process * ap = (Process *) a;
+  Process * bp = (Process *) b;
+  return ap->tmpl->total - bp->tmpl->total; // sort so head is least total first
+}
+
+/**
+ * Shortest Remaining Time First: Compares 2 processes in a queue based on their remaining execution time
+ * @param  a    First process
+ * @param  b    Second process
+ * @param  data unused var
+ * @return      a negative value if a < b, 0 if a = b, a positive value if a > b
+ */
+gint sort_srtf(gconstpointer a, gconstpointer b, gpointer data) {
+  Process * ap = (Process *) a;
+  Process * bp = (Process *) b;
+  return ap->remaining - bp->remaining; // sort so head is least remaining time first
+}
+
+gint (*fcfs_algorithm)(gconstpointer,gconstpointer,gpointer);
+gint (*sjf_algorithm)(gconstpointer,gconstpointer,gpointer);
+gint (*srtf_algorithm)(gconstpointer,gconstpointer,gpointer);
+
+GHashTable * process_templates; //interned process templates: ProcessTemplate --> itself
+GMutex process_templates_lock; //guards the interned process templates
+GHashTable * burst_programs; //interned burst programs: struct burst_program --> itself
+GMutex burst_programs_lock; //guards the interned burst programs
+
+/**
+ * Hashes a process template
+ * @param  key the template
+ * @return     the hash
+ */
+guint process_template_hash(gconstpointer key) {
+  const ProcessTemplate * t = key;
+  guint h = (((t->total * 31u + t->iofreq) * 31u + t->iodur) * 31u + t->rr) * 31u + t->period;
+  return (h * 31u + t->deadline) * 31u + g_direct_hash(t->program);
+}
+
+/**
+ * Compares two process templates
+ * @param  a First template
+ * @param  b Second template
+ * @return   TRUE if they hold the same values
+ */
+gboolean process_template_equal(gconstpointer a, gconstpointer b) {
+  return memcmp(a, b, sizeof(ProcessTemplate)) == 0;
+}
+
+/**
+ * Gets the interned process template holding the same values as a template, interning a copy of
+ * it first if it is new. Templates are shared by every process, simulation and thread, and live
+ * as long as the program.
+ * @param  key the values
+ * @return     the template
+ */
+const ProcessTemplate * template_intern(const ProcessTemplate * key) {
+  ProcessTemplate * t;
+
+  g_mutex_lock(&process_templates_lock);
+  if(process_templates == NULL) process_templates = g_hash_table_new(process_template_hash, process_template_equal);
+  if((t = g_hash_table_lookup(process_templates, key)) == NULL) {
+    t = malloc(sizeof(ProcessTemplate));
+    assert(t != NULL);
+    *t = *key;
+    g_hash_table_insert(process_templates, t, t);
+  }
+  g_mutex_unlock(&process_templates_lock);
+  return t;
+}
+
+/**
+ * Gets the interned process template with the given values, interning it first if it is new
+ * @param  total   Total execution time
+ * @param  iofreq  how oftem the process does I/O
+ * @param  iodur   I/O duration time
+ * @param  rr      round robin frequency
+ * @param  program burst program, from burst_program() (NULL for none)
+ * @return         the template
+ */
+const ProcessTemplate * process_template(int total, int iofreq, int iodur, int rr, const struct burst_program * program) {
+  ProcessTemplate key = { total, iofreq, iodur, rr, 0, 0, program };
+  return template_intern(&key);
+}
+
+/**
+ * Gets the interned template of the jobs of a periodic task: they run for their worst case
+ * execution time, with no I/O and no time slice
+ * @param  wcet     worst case execution time
+ * @param  period   time between releases
+ * @param  deadline time after its release a job is due by
+ * @return          the template
+ */
+const ProcessTemplate * periodic_template(int wcet, int period, int deadline) {
+  ProcessTemplate key = { wcet, INT_MAX, INT_MAX, INT_MAX, period, deadline, NULL };
+  return template_intern(&key);
+}
+
+/**
+ * Hashes a burst program
+ * @param  key the program
+ * @return     the hash
+ */
+guint burst_program_hash(gconstpointer key) {
+  const struct burst_program * b = key;
+  guint h = b->count, i;
+
+  for(i = 0; i < b->count; i++) h = ((h * 31u + b->phases[i].cpu) * 31u + b->phases[i].io) * 31u + b->phases[i].count;
+  return h;
+}
+
+/**
+ * Compares two burst programs
+ * @param  a First program
+ * @param  b Second program
+ * @return   TRUE if they have the same phases
+ */
+gboolean burst_program_equal(gconstpointer a, gconstpointer b) {
+  const struct burst_program * x = a, * y = b;
+  return x->count == y->count && memcmp(x->phases, y->phases, x->count * sizeof(struct burst_phase)) == 0;
+}
+
+/**
+ * Gets the interned burst program with the given phases, interning it first if it is new. Like
+ * templates, programs live as long as the program.
+ * @param  phases the phases, no two neighbours with the same bursts
+ * @param  count  number of phases, at least 1
+ * @return        the program
+ */
+const struct burst_program * burst_program(const struct burst_phase * phases, guint count) {
+  struct burst_program * b = malloc(sizeof(struct burst_program) + count * sizeof(struct burst_phase)), * t;
+
+  assert(b != NULL && count > 0);
+  b->count = count;
+  memcpy(b->phases, phases, count * sizeof(struct burst_phase));
+  g_mutex_lock(&burst_programs_lock);
+  if(burst_programs == NULL) burst_programs = g_hash_table_new(burst_program_hash, burst_program_equal);
+  if((t = g_hash_table_lookup(burst_programs, b)) == NULL) g_hash_table_insert(burst_programs, b, b);
+  g_mutex_unlock(&burst_programs_lock);
+  if(t == NULL) return b;
+  free(b);
+  return t;
+}
+
+/**
+ * Initializes a process of a template
+ * @param  p     memory to initialize the process in, a recycled slot (NULL to allocate it)
+ * @param  pid   Process' PID
+ * @param  start start time
+ * @param  tmpl  the template, from process_template()
+ * @return       pointer to the initialized variable
+ */
+Process * process_instantiate(Process * p, int pid, int start, const ProcessTemplate * tmpl) {
+  int i;
+
+  if(p == NULL) p = malloc(sizeof(Process));
+  assert (p != NULL);
+  p->pid = pid; //process id
+  p->start = start; //start time
+  p->tmpl = tmpl; //total, iofreq, iodur and rr
+  p->remaining = tmpl->total; //remaining amount of cpu time to execute
+  p->cpu = NO_CPU; //not running yet
+  p->last_cpu = NO_CPU; //never ran
+  p->last_stop = 0;
+  p->node = NO_NODE; //placed on first touch
+  p->mem = 0;
+  p->job = NO_JOB;
+  p->gang = NULL;
+  p->ready_since = start;
+  p->wait_time = 0;
+  p->finish = 0;
+  for(i = 0; i < NUM_TIMERS; i++) p->timer[i] = NO_TIMER; //no pending events
+  p->phase = 0; //first burst of its program
+  p->burst = 0;
+  return p;
+}
+
+/**
+ * Initializes a process with passed in paramaters
+ * @param  pid    Process' PID
+ * @param  start  start time
+ * @param  total  Total execution time
+ * @param  iofreq how oftem the process does I/O
+ * @param  iodur  I/O duration time
+ * @param  rr     round robin frequency
+ * @return        pointer to the initialized variable
+ */
+Process * process_new(int pid, int start, int total, int iofreq, int iodur, int rr) {
+  return process_instantiate(NULL, pid, start, process_template(total, iofreq, iodur, rr, NULL));
+}
+
+/**
+ * Gets the cpu time a process runs for once put on a cpu before it does I/O
+ * @param  p the process
+ * @return   iofreq, or the cpu burst its burst program is at (INT_MAX once the program ran out:
+ *           no more I/O)
+ */
+int burst_cpu(const Process * p) {
+  const struct burst_program * b = p->tmpl->program;
+
+  if(b == NULL) return p->tmpl->iofreq;
+  return p->phase < b->count ? b->phases[p->phase].cpu : INT_MAX;
+}
+
+/**
+ * Gets the duration of the I/O a process does after its cpu burst
+ * @param  p the process
+ * @return   iodur, or the I/O burst its burst program is at (INT_MAX once the program ran out)
+ */
+int burst_io(const Process * p) {
+  const struct burst_program * b = p->tmpl->program;
+
+  if(b == NULL) return p->tmpl->iodur;
+  return p->phase < b->count ? b->phases[p->phase].io : INT_MAX;
+}
+
+/**
+ * Moves a process that completed its I/O on to the next burst of its burst program
+ * @param p the process
+ */
+void burst_next(Process * p) {
+  const struct burst_program * b = p->tmpl->program;
+
+  if(b != NULL && p->phase < b->count && ++p->burst == (guint) b->phases[p->phase].count) {
+    p->phase++;
+    p->burst = 0;
+  }
+}
+
+char * get_state_string(int state) {
+  switch(state) {
+    case READY_STATE:
+      return READY_STATE_STR;
+    break;
+
+    case RUNNING_STATE:
+      return RUNNING_STATE_STR;
+    break;
+
+    case WAITING_STATE:
+      return WAITING_STATE_STR;
+    break;
+
+    case TERMINATED_STATE:
+      return TERMINATED_STATE_STR;
+    break;
+
+    case NEW_STATE:
+      return NEW_STATE_STR;
+    break;
+
+    case REJECTED_STATE:
+      return REJECTED_STATE_STR;
+    break;
+
+    case BLOCKED_STATE:
+      return BLOCKED_STATE_STR;
+    break;
+
+    default:
+      return UNKNOWN_STATE_STR;
+    break;
+  }
+}
+
+/**
+ * Writes a state transition to a trace file
+ * @param file the trace file (opened for appending)
+ * @param tot  time of the transition
+ * @param pid  process id
+ * @param old  old state
+ * @param new  new state
+ * @return     number of bytes written
+ */
+int write_update(FILE * file, int tot, int pid, int old, int new) {
+  return fprintf(file, TRACE_FORMAT, tot, pid, get_state_string(old), get_state_string(new)); //writes
+}
+
+/**
+ * Writes results to a file
+ * @param filename name of file
+ * @param val      what to write (append)
+ */
+void write_to_file(const char * filename, const char * val) {
+  FILE *file;
+
+  file = fopen(filename,"a+"); /* apend file (add text to a file or create a file if it does not exist.*/
+  fprintf(file, "%s", val); //writes
+  fclose(file); //done writing to file
+}
+
+/**
+ * Starts the index of a text trace
+ * @param  filename name of the trace, the index gets ".tix" appended (overwritten)
+ * @param  trace    the trace, opened for appending
+ * @return          the trace index
+ */
+struct trace_index * trace_index_open(const char * filename, FILE * trace) {
+  struct trace_index * ti = calloc(1, sizeof(struct trace_index));
+  char * index = g_strconcat(filename, ".tix", NULL);
+
+  assert(ti != NULL);
+  ti->file = fopen(index, "wb");
+  assert(ti->file != NULL);
+  g_free(index);
+  ti->filename = g_strdup(filename);
+  fseek(trace, 0, SEEK_END); //the run is appended to whatever the trace already holds
+  ti->offset = ftell(trace);
+  ti->chunks = g_array_new(FALSE, FALSE, sizeof(struct trace_block_entry));
+  ti->pids = g_hash_table_new(g_direct_hash, g_direct_equal);
+  if(TRACE_PID_INDEX) ti->postings = g_hash_table_new(g_direct_hash, g_direct_equal);
+  return ti;
+}
+
+/**
+ * Appends a number to a byte array as a varint
+ * @param a the array
+ * @param v the number
+ */
+void varint_append(GByteArray * a, guint64 v) {
+  guint8 b;
+
+  for(; v >= 0x80; v >>= 7) {
+    b = (v & 0x7f) | 0x80;
+    g_byte_array_append(a, &b, 1);
+  }
+  b = v;
+  g_byte_array_append(a, &b, 1);
+}
+
+/**
+ * Adds the offset of a line to the posting list of its pid
+ * @param postings pid --> struct trace_postings
+ * @param pid      process id
+ * @param offset   offset of the line in the trace
+ */
+void trace_postings_add(GHashTable * postings, int pid, guint64 offset) {
+  struct trace_postings * p = g_hash_table_lookup(postings, GINT_TO_POINTER(pid));
+
+  if(p == NULL) {
+    p = calloc(1, sizeof(struct trace_postings));
+    assert(p != NULL);
+    p->data = g_byte_array_new();
+    g_hash_table_insert(postings, GINT_TO_POINTER(pid), p);
+  }
+  varint_append(p->data, offset - p->last);
+  p->last = offset;
+  p->count++;
+}
+
+/**
+ * Writes the posting lists of a trace, in pid order, and frees them
+ * @param filename name of the posting list file (overwritten)
+ * @param postings pid --> struct trace_postings
+ * @param pids     the pids, sorted
+ */
+void trace_postings_write(const char * filename, GHashTable * postings, GArray * pids) {
+  FILE * file = fopen(filename, "wb");
+  struct trace_postings * p;
+  struct trace_pid_entry e;
+  guint32 counts[2] = { pids->len, 0 };
+  guint i;
+
+  assert(file != NULL);
+  for(i = 0; i < pids->len; i++) {
+    p = g_hash_table_lookup(postings, GINT_TO_POINTER(g_array_index(pids, gint32, i)));
+    counts[1] += p->count;
+  }
+  fwrite(TRACE_PID_INDEX_MAGIC, 1, strlen(TRACE_PID_INDEX_MAGIC), file);
+  fwrite(counts, sizeof(guint32), 2, file);
+  e.position = 0;
+  for(i = 0; i < pids->len; i++) {
+    e.pid = g_array_index(pids, gint32, i);
+    p = g_hash_table_lookup(postings, GINT_TO_POINTER(e.pid));
+    e.count = p->count;
+    fwrite(&e, sizeof(e), 1, file);
+    e.position += p->data->len;
+  }
+  for(i = 0; i < pids->len; i++) {
+    p = g_hash_table_lookup(postings, GINT_TO_POINTER(g_array_index(pids, gint32, i)));
+    fwrite(p->data->data, 1, p->data->len, file);
+    g_byte_array_free(p->data, TRUE);
+    free(p);
+  }
+  g_hash_table_destroy(postings);
+  fclose(file);
+}
+
+/**
+ * Adds the last line indexed to the chunks and the posting list of a pid
+ * @param ti    the trace index
+ * @param pid   process id
+ * @param bytes length of the line
+ */
+void trace_index_pid(struct trace_index * ti, int pid, int bytes) {
+  GArray * chunks = g_hash_table_lookup(ti->pids, GINT_TO_POINTER(pid));
+  guint32 n = ti->chunks->len - 1;
+
+  if(chunks == NULL) {
+    chunks = g_array_new(FALSE, FALSE, sizeof(guint32));
+    g_hash_table_insert(ti->pids, GINT_TO_POINTER(pid), chunks);
+  }
+  if(chunks->len == 0 || g_array_index(chunks, guint32, chunks->len - 1) != n) g_array_append_val(chunks, n);
+  if(ti->postings != NULL) trace_postings_add(ti->postings, pid, ti->offset - bytes);
+}
+
+/**
+ * Adds a line of the trace to its index
+ * @param ti         the trace index
+ * @param time       time of the transition
+ * @param last_time  time of the last transition the line stands for (time but for REPEAT records)
+ * @param pid        process id
+ * @param bytes      length of the line
+ */
+void trace_index_add(struct trace_index * ti, int time, int last_time, int pid, int bytes) {
+  struct trace_block_entry * c;
+  guint32 n = ti->chunks->len;
+
+  if(n == 0 || g_array_index(ti->chunks, struct trace_block_entry, n - 1).length >= TRACE_INDEX_CHUNK) {
+    struct trace_block_entry e = { time, time, ti->offset, 0, 0 };
+    g_array_append_val(ti->chunks, e);
+    n++;
+  }
+  c = &g_array_index(ti->chunks, struct trace_block_entry, n - 1);
+  c->last_time = last_time;
+  c->length += bytes;
+  c->size = c->length;
+  ti->offset += bytes;
+  trace_index_pid(ti, pid, bytes);
+}
+
+/**
+ * Adds a pid of a trace index to an array of pids
+ * @param key   the pid
+ * @param value its chunks
+ * @param user  the array
+ */
+void trace_index_collect(gpointer key, gpointer value, gpointer user) {
+  gint32 pid = GPOINTER_TO_INT(key);
+
+  g_array_append_val((GArray *) user, pid);
+}
+
+/**
+ * Orders pids
+ */
+gint compare_pids(gconstpointer a, gconstpointer b) {
+  gint32 x = *(const gint32 *) a, y = *(const gint32 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Writes out a trace index and closes it
+ * @param ti the trace index
+ */
+void trace_index_close(struct trace_index * ti) {
+  GArray * pids = g_array_new(FALSE, FALSE, sizeof(gint32));
+  GArray * chunks;
+  struct trace_pid_entry e;
+  guint32 counts[2];
+  char * postings;
+  guint i;
+
+  g_hash_table_foreach(ti->pids, trace_index_collect, pids);
+  g_array_sort(pids, compare_pids);
+  counts[0] = ti->chunks->len;
+  counts[1] = pids->len;
+  fwrite(TRACE_TIME_INDEX_MAGIC, 1, strlen(TRACE_TIME_INDEX_MAGIC), ti->file);
+  fwrite(counts, sizeof(guint32), 2, ti->file);
+  fwrite(ti->chunks->data, sizeof(struct trace_block_entry), ti->chunks->len, ti->file);
+  e.position = 0;
+  for(i = 0; i < pids->len; i++) {
+    e.pid = g_array_index(pids, gint32, i);
+    e.count = ((GArray *) g_hash_table_lookup(ti->pids, GINT_TO_POINTER(e.pid)))->len;
+    fwrite(&e, sizeof(e), 1, ti->file);
+    e.position += e.count;
+  }
+  for(i = 0; i < pids->len; i++) {
+    chunks = g_hash_table_lookup(ti->pids, GINT_TO_POINTER(g_array_index(pids, gint32, i)));
+    fwrite(chunks->data, sizeof(guint32), chunks->len, ti->file);
+    g_array_free(chunks, TRUE);
+  }
+  if(ti->postings != NULL) {
+    postings = g_strconcat(ti->filename, ".pix", NULL);
+    trace_postings_write(postings, ti->postings, pids);
+    g_free(postings);
+  }
+  g_array_free(pids, TRUE);
+  g_array_free(ti->chunks, TRUE);
+  g_free(ti->filename);
+  g_hash_table_destroy(ti->pids);
+  fclose(ti->file);
+  free(ti);
+}
+
+/**
+ * Compresses a block of a compressed trace into a gzip member, on a worker thread
+ * @param data the block
+ * @param user the trace writer
+ */
+void compress_block(gpointer data, gpointer user) {
+  struct trace_block * b = data;
+  struct trace_writer * w = user;
+  z_stream z;
+  int ret;
+
+  memset(&z, 0, sizeof(z));
+  ret = deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY); //15 + 16: gzip wrapper
+  assert(ret == Z_OK);
+  b->data = malloc(deflateBound(&z, b->text->len));
+  assert(b->data != NULL);
+  z.next_in = (Bytef *) b->text->str;
+  z.avail_in = b->text->len;
+  z.next_out = b->data;
+  z.avail_out = deflateBound(&z, b->text->len);
+  ret = deflate(&z, Z_FINISH);
+  assert(ret == Z_STREAM_END);
+  b->size = z.total_out;
+  deflateEnd(&z);
+
+  g_mutex_lock(&w->lock);
+  b->done = TRUE;
+  g_cond_broadcast(&w->compressed);
+  g_mutex_unlock(&w->lock);
+}
+
+/**
+ * Creates a compressed trace and its block index
+ * @param  filename name of the compressed trace (overwritten), the index gets ".idx" appended
+ * @param  title    first line of the trace
+ * @return          the trace writer
+ */
+struct trace_writer * trace_writer_open(const char * filename, const char * title) {
+  struct trace_writer * w = calloc(1, sizeof(struct trace_writer));
+  char * index = g_strconcat(filename, ".idx", NULL);
+
+  assert(w != NULL);
+  w->file = fopen(filename, "wb");
+  w->index = fopen(index, "wb");
+  assert(w->file != NULL && w->index != NULL);
+  g_free(index);
+  fwrite(TRACE_INDEX_MAGIC, 1, strlen(TRACE_INDEX_MAGIC), w->index);
+  g_mutex_init(&w->lock);
+  g_cond_init(&w->compressed);
+  w->pending = g_queue_new();
+  w->pool = g_thread_pool_new(compress_block, w, TRACE_WORKERS, TRUE, NULL);
+  w->block = calloc(1, sizeof(struct trace_block));
+  assert(w->block != NULL);
+  w->block->text = g_string_sized_new(TRACE_BLOCK_SIZE + MAX_LINE);
+  w->block->first_time = w->block->last_time = -1;
+  g_string_append(w->block->text, title);
+  g_string_append(w->block->text, TRACE_HEADER);
+  return w;
+}
+
+/**
+ * Writes the compressed blocks at the head of the pending blocks, in order
+ * @param w        the trace writer
+ * @param in_limit wait for blocks until at most this many are pending
+ */
+void trace_writer_drain(struct trace_writer * w, guint in_limit) {
+  struct trace_block * b;
+  struct trace_block_entry e;
+
+  g_mutex_lock(&w->lock);
+  while((b = g_queue_peek_head(w->pending)) != NULL) {
+    if(!b->done) {
+      if(g_queue_get_length(w->pending) <= in_limit) break;
+      g_cond_wait(&w->compressed, &w->lock);
+      continue;
+    }
+    g_queue_pop_head(w->pending);
+    g_mutex_unlock(&w->lock);
+
+    e.first_time = b->first_time;
+    e.last_time = b->last_time;
+    e.offset = w->offset;
+    e.size = b->size;
+    e.length = b->text->len;
+    fwrite(b->data, 1, b->size, w->file);
+    fwrite(&e, sizeof(e), 1, w->index);
+    w->offset += b->size;
+    g_string_free(b->text, TRUE);
+    free(b->data);
+    free(b);
+    g_mutex_lock(&w->lock);
+  }
+  g_mutex_unlock(&w->lock);
+}
+
+/**
+ * Hands the current block to the compressor threads and starts a new one
+ * @param w the trace writer
+ */
+void trace_writer_submit(struct trace_writer * w) {
+  struct trace_block * b = w->block;
+
+  g_mutex_lock(&w->lock);
+  g_queue_push_tail(w->pending, b);
+  g_mutex_unlock(&w->lock);
+  g_thread_pool_push(w->pool, b, NULL);
+
+  w->block = calloc(1, sizeof(struct trace_block));
+  assert(w->block != NULL);
+  w->block->text = g_string_sized_new(TRACE_BLOCK_SIZE + MAX_LINE);
+  w->block->first_time = w->block->last_time = -1;
+  trace_writer_drain(w, 2 * TRACE_WORKERS); //keeps the memory held by pending blocks bounded
+}
+
+/**
+ * Adds a state transition to a compressed trace
+ * @param w    the trace writer
+ * @param time time of the transition
+ * @param pid  process id
+ * @param old  old state
+ * @param new  new state
+ */
+void trace_writer_add(struct trace_writer * w, int time, int pid, int old, int new) {
+  struct trace_block * b = w->block;
+
+  if(b->first_time < 0) b->first_time = time;
+  b->last_time = time;
+  g_string_append_printf(b->text, TRACE_FORMAT, time, pid, get_state_string(old), get_state_string(new));
+  if(b->text->len >= TRACE_BLOCK_SIZE) trace_writer_submit(w);
+}
+
+/**
+ * Adds a line other than a state transition to a compressed trace
+ * @param w          the trace writer
+ * @param time       time of the line
+ * @param last_time  time of the last transition the line stands for
+ * @param line       the line
+ */
+void trace_writer_line(struct trace_writer * w, int time, int last_time, const char * line) {
+  struct trace_block * b = w->block;
+
+  if(b->first_time < 0) b->first_time = time;
+  b->last_time = last_time;
+  g_string_append(b->text, line);
+  if(b->text->len >= TRACE_BLOCK_SIZE) trace_writer_submit(w);
+}
+
+/**
+ * Writes out the rest of a compressed trace and closes it
+ * @param w the trace writer
+ */
+void trace_writer_close(struct trace_writer * w) {
+  if(w->block->text->len > 0) trace_writer_submit(w);
+  trace_writer_drain(w, 0);
+  g_thread_pool_free(w->pool, FALSE, TRUE);
+  g_string_free(w->block->text, TRUE);
+  free(w->block);
+  g_queue_free(w->pending);
+  g_mutex_clear(&w->lock);
+  g_cond_clear(&w->compressed);
+  fclose(w->file);
+  fclose(w->index);
+  free(w);
+}
+
+/**
+ * Gets the template of the shared values of a workload record, replacing values that are out of
+ * range
+ * @param  total   Total execution time
+ * @param  iofreq  how oftem the process does I/O
+ * @param  iodur   I/O duration time
+ * @param  rr      round robin frequency
+ * @param  program burst program, in place of iofreq and iodur (NULL for none)
+ * @return         the template
+ */
+const ProcessTemplate * template_from_record(int total, int iofreq, int iodur, int rr, const struct burst_program * program) {
+  iofreq = iofreq <= 0 ? INT_MAX : iofreq; // assume to be no I/O if given negative or 0 (happens only at max simulation time)
+  iodur = iodur <= 0 ? INT_MAX : iodur; //assume to be no I/O if given negative or 0 (happens only at max simulation time)
+  rr = rr <= 0 ? INT_MAX : rr; // assume to be no preemption if given negative or 0 (happens only at max simulation time)
+  total = total < 0 ? 0 : total; //assume to be zero if given negative value
+  return process_template(total, iofreq, iodur, rr, program);
+}
+
+/**
+ * Initializes a process of a template from the per process values of a workload record,
+ * replacing values that are out of range
+ * @param  slot  memory to initialize the process in (NULL to allocate it)
+ * @param  tmpl  the template
+ * @param  pid   Process' PID
+ * @param  start start time
+ * @param  node  numa node of the process' memory
+ * @param  mem   memory used by the process
+ * @param  job   parallel job of the process
+ * @return       pointer to the initialized process
+ */
+Process * process_from_template(Process * slot, const ProcessTemplate * tmpl, int pid, int start, int node, int mem, int job) {
+  Process * p;
+
+  start = start < 0 ? 0 : start; //assume to be zero if given negative value
+  node = node < 0 || node >= topology->num_nodes ? NO_NODE : node; //unknown nodes are placed on first touch
+  mem = mem < 0 ? 0 : mem;
+  job = job < 0 ? NO_JOB : job;
+
+  p = process_instantiate(slot, pid, start, tmpl);
+  p->node = node;
+  p->mem = mem;
+  p->job = job;
+  return p;
+}
+
+/**
+ * Initializes a process from the raw values of a workload record, replacing values that are
+ * out of range
+ * @param  v the record: pid, start, total, iofreq, iodur, rr, node, mem, job
+ * @return   pointer to the initialized process
+ */
+Process * process_from_record(const int v[RECORD_FIELDS]) {
+  return process_from_template(NULL, template_from_record(v[2], v[3], v[4], v[5], NULL), v[0], v[1], v[6], v[7], v[8]);
+}
+
+/**
+ * Parses one line of text input data into a workload record
+ * @param  line the line
+ * @param  v    the record to fill in (optional columns get their defaults)
+ * @return      the number of columns read, EOF for a blank line
+ */
+int parse_record(const char * line, int v[RECORD_FIELDS]) {
+  v[6] = NO_NODE; //optional columns
+  v[7] = 0;
+  v[8] = NO_JOB;
+  return sscanf(line, "%d,%d,%d,%d,%d,%d,%d,%d,%d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]);
+}
+
+/**
+ * Parses the phases of a burst program, ",<cpu>,<io>,<count>" each, merging neighbours with the
+ * same bursts
+ * @param  s the phases
+ * @return   the interned program, NULL if there are none or a value is not positive
+ */
+const struct burst_program * parse_burst_program(const char * s) {
+  struct burst_phase phases[MAX_LINE / 6]; //a phase takes at least 6 characters of a line
+  guint count = 0;
+  char * end;
+  int v[3], i;
+
+  while(*s == ',') {
+    for(i = 0; i < 3; i++) {
+      if(*s != ',') return NULL;
+      v[i] = strtol(s + 1, &end, 10);
+      if(end == s + 1 || v[i] <= 0) return NULL;
+      s = end;
+    }
+    if(count > 0 && phases[count - 1].cpu == v[0] && phases[count - 1].io == v[1]) {
+      phases[count - 1].count = v[2] > INT_MAX - phases[count - 1].count ? INT_MAX : phases[count - 1].count + v[2];
+    }
+    else phases[count++] = (struct burst_phase) { v[0], v[1], v[2] };
+  }
+  return count > 0 ? burst_program(phases, count) : NULL;
+}
+
+/**
+ * Parses one line of text input data into a process. Besides records, a line can define a
+ * template of the shared values of a workload, "T,<template>,<total>,<iofreq>,<iodur>,<rr>", or
+ * a template whose I/O follows a burst program instead,
+ * "P,<template>,<total>,<rr>,<cpu>,<io>,<count>[,<cpu>,<io>,<count>...]": count times over, run
+ * for cpu then do I/O for io, phase after phase, then run with no more I/O. A line can also
+ * make a process of a template, "I,<template>,<pid>,<start>[,<node>,<mem>,<job>]", which reads
+ * only the per process values.
+ * @param  line      the line
+ * @param  templates the templates defined so far by the data: template id --> ProcessTemplate
+ * @param  p         memory to make the process in, a recycled slot (NULL to allocate it), set to
+ *                   the process if the line makes one
+ * @return           the number of columns of the record read (a process of a template counts
+ *                   as its whole record), RECORD_TEMPLATE for a template, EOF for a blank line
+ */
+int parse_process(const char * line, GHashTable * templates, Process ** p) {
+  const ProcessTemplate * tmpl;
+  const struct burst_program * program;
+  int v[RECORD_FIELDS], fields;
+
+  if(line[0] == 'T') {
+    if(sscanf(line, "T,%d,%d,%d,%d,%d", &v[0], &v[2], &v[3], &v[4], &v[5]) < 5) return 0;
+    g_hash_table_insert(templates, GINT_TO_POINTER(v[0]), (gpointer) template_from_record(v[2], v[3], v[4], v[5], NULL));
+    return RECORD_TEMPLATE;
+  }
+  if(line[0] == 'P') {
+    if(sscanf(line, "P,%d,%d,%d%n", &v[0], &v[2], &v[5], &fields) < 3 || (program = parse_burst_program(line + fields)) == NULL) return 0;
+    g_hash_table_insert(templates, GINT_TO_POINTER(v[0]), (gpointer) template_from_record(v[2], 0, 0, v[5], program));
+    return RECORD_TEMPLATE;
+  }
+  if(line[0] == 'I') {
+    v[6] = NO_NODE; //optional columns
+    v[7] = 0;
+    v[8] = NO_JOB;
+    fields = sscanf(line, "I,%d,%d,%d,%d,%d,%d", &v[2], &v[0], &v[1], &v[6], &v[7], &v[8]);
+    if(fields < 3 || (tmpl = g_hash_table_lookup(templates, GINT_TO_POINTER(v[2]))) == NULL) return 0;
+    *p = process_from_template(*p, tmpl, v[0], v[1], v[6], v[7], v[8]);
+    return fields + 3;
+  }
+  fields = parse_record(line, v);
+  if(fields >= 6) *p = process_from_template(*p, template_from_record(v[2], v[3], v[4], v[5], NULL), v[0], v[1], v[6], v[7], v[8]);
+  return fields;
+}
+
+/**
+ * Parses a line of text input data giving the parents of a job, "D,<pid>,<parent>[,<parent>...]":
+ * the processes with that pid can not start before every process of each parent terminated.
+ * Jobs with more parents than fit on a line take several D lines.
+ * @param  line  the line
+ * @param  edges array the dependencies are appended to, as struct dependency
+ * @return       RECORD_DEPENDENCY, 0 if the line is not a dependency line
+ */
+int parse_dependencies(const char * line, GArray * edges) {
+  struct dependency d;
+  const char * s;
+  char * end;
+  guint len = edges->len;
+
+  if(line[0] != 'D' || line[1] != ',') return 0;
+  d.pid = strtol(line + 2, &end, 10);
+  if(end == line + 2) return 0;
+  for(s = end; *s == ','; s = end) {
+    d.parent = strtol(s + 1, &end, 10);
+    if(end == s + 1) break;
+    g_array_append_val(edges, d);
+  }
+  return edges->len > len ? RECORD_DEPENDENCY : 0;
+}
+
+/**
+ * Parses a line of text input data declaring a lock, "L,<lock>,<units>", or a critical section of
+ * the processes with a pid, "C,<pid>,<at>,<lock>,<length>": after <at> units of cpu time they
+ * acquire the lock, and they release it <length> units of cpu time later. Locks not declared are
+ * mutexes. Sections may nest, and a process terminating releases the locks it still holds.
+ * @param  line  the line
+ * @param  locks the locks and sections read so far
+ * @return       RECORD_LOCK, 0 if the line is not a lock or section line
+ */
+int parse_locks(const char * line, struct lock_spec * locks) {
+  struct lock_units u;
+  struct critical_section c;
+
+  if(sscanf(line, "L,%d,%d", &u.lock, &u.units) == 2) {
+    g_array_append_val(locks->units, u);
+    return RECORD_LOCK;
+  }
+  if(sscanf(line, "C,%d,%d,%d,%d", &c.pid, &c.at, &c.lock, &c.length) == 4) {
+    g_array_append_val(locks->sections, c);
+    return RECORD_LOCK;
+  }
+  return 0;
+}
+
+/**
+ * Parses a line of text input data declaring a periodic task, "R,<pid>,<offset>,<period>,<wcet>[,<deadline>]":
+ * from <offset> on, a job with that pid is released every <period>, runs for <wcet> units of cpu
+ * time and is due <deadline> after its release (its period if not given). Jobs do no I/O and are
+ * never time sliced.
+ * @param  line  the line
+ * @param  tasks array the task is appended to, as struct periodic_task
+ * @return       RECORD_PERIODIC, 0 if the line is not a periodic task line
+ */
+int parse_periodic(const char * line, GArray * tasks) {
+  struct periodic_task t = { 0 };
+
+  if(sscanf(line, "R,%d,%d,%d,%d,%d", &t.pid, &t.offset, &t.period, &t.wcet, &t.deadline) < 4 || t.period <= 0) return 0;
+  t.offset = t.offset < 0 ? 0 : t.offset; //assume to be zero if given negative value
+  t.wcet = t.wcet < 0 ? 0 : t.wcet;
+  t.deadline = t.deadline <= 0 ? t.period : t.deadline; //implicit deadline
+  g_array_append_val(tasks, t);
+  return RECORD_PERIODIC;
+}
+
+/**
+ * Reads processes from text input data until the end of the data or the first invalid line
+ * @param  fp           the text input data
+ * @param  dependencies array the dependencies of D lines are appended to (NULL if D lines are
+ *                      invalid)
+ * @param  locks        the locks and sections of L and C lines are added to it (NULL if L and
+ *                      C lines are invalid)
+ * @param  tasks        array the periodic tasks of R lines are appended to (NULL if R lines are
+ *                      invalid)
+ * @return              queue of processes
+ */
+GQueue * parse_stream(FILE * fp, GArray * dependencies, struct lock_spec * locks, GArray * tasks) {
+  GHashTable * templates = g_hash_table_new(g_direct_hash, g_direct_equal);
+  GQueue * queue = g_queue_new();
+  char line[MAX_LINE];
+  Process * p;
+  int fields;
+
+  while(fgets(line, sizeof(line), fp) != NULL) {
+    p = NULL;
+    if(line[0] == 'D' && dependencies != NULL) fields = parse_dependencies(line, dependencies);
+    else if((line[0] == 'L' || line[0] == 'C') && locks != NULL) fields = parse_locks(line, locks);
+    else if(line[0] == 'R' && tasks != NULL) fields = parse_periodic(line, tasks);
+    else fields = parse_process(line, templates, &p);
+    if(fields == EOF || fields == RECORD_TEMPLATE || fields == RECORD_DEPENDENCY || fields == RECORD_LOCK
+      || fields == RECORD_PERIODIC) continue; //not a process
+    if(fields < 6) break;
+    g_queue_push_head(queue, p);
+  }
+  g_hash_table_destroy(templates);
+  return queue;
+}
+
+/**
+ * Creates a queue of processes from the text input data
+ * @param  filename     name of file
+ * @param  dependencies array the dependencies of D lines are appended to (NULL if D lines are
+ *                      invalid)
+ * @param  locks        the locks and sections of L and C lines are added to it (NULL if L and
+ *                      C lines are invalid)
+ * @param  tasks        array the periodic tasks of R lines are appended to (NULL if R lines are
+ *                      invalid)
+ * @return              queue of processes
+ */
+GQueue * parse_file(const char * filename, GArray * dependencies, struct lock_spec * locks, GArray * tasks) {
+  GQueue * queue;
+  FILE * fp;
+
+  if((fp = fopen(filename, "r+")) == NULL) {
+    printf("No such file\n");
+    exit(1);
+  }
+
+  queue = parse_stream(fp, dependencies, locks, tasks);
+
+  if(feof(fp)) {
+    printf("Finished processing %s\n", filename);
+  }
+  else {
+    printf("Error reading! Invalid format!\n");
+  }
+  fclose(fp);
+  return queue;
+}
+
+/**
+ * Allocates an empty cpu set
+ * @param  words number of words in the set
+ * @return       the cpu set
+ */
+CpuSet * cpu_set_new(int words) {
+  CpuSet * set = calloc(words, sizeof(CpuSet));
+  assert(set != NULL);
+  return set;
+}
+
+/**
+ * Adds a cpu to a cpu set
+ * @param set the cpu set
+ * @param cpu the cpu
+ */
+void cpu_set_add(CpuSet * set, int cpu) {
+  set[cpu / 64] |= (CpuSet) 1 << (cpu % 64);
+}
+
+/**
+ * Removes a cpu from a cpu set
+ * @param set the cpu set
+ * @param cpu the cpu
+ */
+void cpu_set_remove(CpuSet * set, int cpu) {
+  set[cpu / 64] &= ~((CpuSet) 1 << (cpu % 64));
+}
+
+/**
+ * Checks if a cpu is in a cpu set
+ * @param  set the cpu set
+ * @param  cpu the cpu
+ * @return     TRUE if the cpu is in the set
+ */
+gboolean cpu_set_has(CpuSet * set, int cpu) {
+  return (set[cpu / 64] >> (cpu % 64)) & 1;
+}
+
+/**
+ * Counts the cpus in a cpu set
+ * @param  set   the cpu set
+ * @param  words number of words in the set
+ * @return       the number of cpus in the set
+ */
+int cpu_set_count(CpuSet * set, int words) {
+  int i, count = 0;
+
+  for(i = 0; i < words; i++) count += __builtin_popcountll(set[i]);
+  return count;
+}
+
+/**
+ * Finds the lowest cpu that is in both cpu sets
+ * @param  set   the cpu set
+ * @param  mask  cpus to restrict the search to (NULL for all cpus)
+ * @param  from  lowest cpu to consider
+ * @param  words number of words in the sets
+ * @return       the cpu, or NO_CPU if there is none
+ */
+int cpu_set_next(CpuSet * set, CpuSet * mask, int from, int words) {
+  int i;
+  CpuSet word;
+
+  for(i = from / 64; i < words; i++) {
+    word = set[i] & (mask != NULL ? mask[i] : ~(CpuSet) 0);
+    if(i == from / 64) word &= ~(CpuSet) 0 << (from % 64); //skip cpus below from in the first word
+    if(word != 0) return i * 64 + __builtin_ctzll(word);
+  }
+  return NO_CPU;
+}
+
+/**
+ * Loads the simulated cpus and numa nodes, from a topology file if given, otherwise
+ * NUM_CPUS cpus on a single node. Topology lines (lines starting with # are ignored):
+ *
+ *   node,<node>,<memory>
+ *   cpu,<cpu>,<node>,<core>
+ *
+ * Cpus are numbered from 0 and must all be listed. Two cpus with the same node and core are
+ * SMT siblings. Nodes without a node line have unlimited memory.
+ * @param  filename name of the topology file ("" for none)
+ * @return          the topology
+ */
+Topology * load_topology(const char * filename) {
+  FILE * fp;
+  char line[MAX_LINE];
+  int id, node, core, memory, i, num_cpus, num_nodes;
+  struct cpu * cpus;
+  struct node * nodes;
+  Topology * topo = malloc(sizeof(Topology));
+
+  assert(topo != NULL);
+  if(strlen(filename) == 0) {
+    topo->num_cpus = NUM_CPUS;
+    topo->num_nodes = 1;
+    topo->cpus = calloc(NUM_CPUS, sizeof(struct cpu));
+    topo->nodes = calloc(1, sizeof(struct node));
+    assert(topo->cpus != NULL && topo->nodes != NULL);
+    for(i = 0; i < NUM_CPUS; i++) topo->cpus[i].core = i;
+    topo->nodes[0].memory = INT_MAX;
+    return topo;
+  }
+
+  if((fp = fopen(filename, "r")) == NULL) {
+    printf("No such topology file\n");
+    exit(1);
+  }
+
+  //first pass sizes the tables, second pass fills them
+  num_cpus = 0;
+  num_nodes = 0;
+  while(fgets(line, sizeof(line), fp) != NULL) {
+    if(sscanf(line, "cpu,%d,%d,%d", &id, &node, &core) == 3) {
+      num_cpus = MAX(num_cpus, id + 1);
+      num_nodes = MAX(num_nodes, node + 1);
+    }
+    else if(sscanf(line, "node,%d,%d", &node, &memory) == 2) num_nodes = MAX(num_nodes, node + 1);
+  }
+  if(num_cpus <= 0) {
+    printf("Error reading! Topology has no cpus!\n");
+    exit(1);
+  }
+
+  cpus = calloc(num_cpus, sizeof(struct cpu));
+  nodes = calloc(num_nodes, sizeof(struct node));
+  assert(cpus != NULL && nodes != NULL);
+  for(i = 0; i < num_cpus; i++) cpus[i].node = NO_NODE;
+  for(i = 0; i < num_nodes; i++) nodes[i].memory = INT_MAX;
+
+  rewind(fp);
+  while(fgets(line, sizeof(line), fp) != NULL) {
+    if(sscanf(line, "cpu,%d,%d,%d", &id, &node, &core) == 3 && id >= 0 && node >= 0) {
+      cpus[id].node = node;
+      cpus[id].core = core;
+    }
+    else if(sscanf(line, "node,%d,%d", &node, &memory) == 2 && node >= 0) nodes[node].memory = memory;
+  }
+  fclose(fp);
+
+  for(i = 0; i < num_cpus; i++) {
+    if(cpus[i].node == NO_NODE) {
+      printf("Error reading! Topology is missing cpu %d!\n", i);
+      exit(1);
+    }
+  }
+  topo->num_cpus = num_cpus;
+  topo->cpus = cpus;
+  topo->num_nodes = num_nodes;
+  topo->nodes = nodes;
+  printf("Loaded topology %s: %d cpus on %d nodes\n", filename, num_cpus, num_nodes);
+  return topo;
+}
+
+/**
+ * Frees a topology loaded by load_topology
+ * @param topo the topology
+ */
+void topology_free(Topology * topo) {
+  free(topo->cpus);
+  free(topo->nodes);
+  free(topo);
+}
+
+/**
+ * Print the size of the queue
+ * @param q queue
+ */
+void print_size_of_queue(GQueue * q) {
+  printf("%d\n", (int) g_queue_get_length(q));
+}
+
+/**
+ * Picks the idle cpu a process gets dispatched to. With affinity the search goes from the
+ * cheapest to the most expensive place to move to: the cpu the process last ran on, an SMT
+ * sibling of it, a cpu on the same node, and only then a cpu on another node. A process that
+ * never ran prefers the node holding its memory.
+ * @param  sim the simulation
+ * @param  p   the process being dispatched
+ * @return     index of an idle cpu
+ */
+int pick_cpu(Simulation * sim, Process * p) {
+  int i, home_node = p->node, home_core = NO_CPU, words = sim->cpu_set_words;
+
+  if(CPU_AFFINITY && p->last_cpu != NO_CPU) {
+    if(cpu_set_has(sim->idle_cpus, p->last_cpu)) return p->last_cpu;
+    home_node = sim->cpus[p->last_cpu].node;
+    home_core = sim->cpus[p->last_cpu].core;
+    for(i = cpu_set_next(sim->idle_cpus, sim->node_cpus[home_node], 0, words); i != NO_CPU;
+        i = cpu_set_next(sim->idle_cpus, sim->node_cpus[home_node], i + 1, words)) {
+      if(sim->cpus[i].core == home_core) return i;
+    }
+  }
+  if(CPU_AFFINITY && home_node != NO_NODE) {
+    i = cpu_set_next(sim->idle_cpus, sim->node_cpus[home_node], 0, words);
+    if(i != NO_CPU) return i;
+  }
+  i = cpu_set_next(sim->idle_cpus, NULL, 0, words);
+  assert(i != NO_CPU); //only called when a cpu is idle
+  return i;
+}
+
+/**
+ * Homes a process' memory on the first node it runs on (first touch), or on the node with
+ * the most free memory if that node is full
+ * @param sim the simulation
+ * @param p   the process
+ * @param cpu the cpu the process first runs on
+ */
+void place_memory(Simulation * sim, Process * p, int cpu) {
+  struct node * nodes = sim->nodes;
+  int i, node = sim->cpus[cpu].node;
+
+  if(nodes[node].memory - nodes[node].used < p->mem) {
+    for(i = 0; i < sim->num_nodes; i++) {
+      if(nodes[i].memory - nodes[i].used > nodes[node].memory - nodes[node].used) node = i;
+    }
+  }
+  p->node = node;
+  nodes[node].used += p->mem;
+}
+
+/**
+ * Extra time the next cpu burst of a process takes when it runs on a cpu away from its memory
+ * @param  sim the simulation
+ * @param  p   the process being dispatched
+ * @param  cpu the cpu it is dispatched to
+ * @return     the inflation of the burst (0 if the memory is local)
+ */
+int remote_memory_penalty(Simulation * sim, Process * p, int cpu) {
+  int burst = MIN(MIN(p->remaining, burst_cpu(p)), p->tmpl->rr);
+
+  if(p->node == sim->cpus[cpu].node) return 0;
+  return (int) ((long long) burst * REMOTE_MEMORY_PENALTY / 100);
+}
+
+/**
+ * Cpu time a process loses by moving away from its last cpu, scaled by how warm the
+ * cache it left behind still is
+ * @param  sim          the simulation
+ * @param  p            the process being dispatched
+ * @param  cpu          the cpu it is dispatched to
+ * @param  current_time current time
+ * @return              the migration penalty (0 if the process does not migrate)
+ */
+int migration_penalty(Simulation * sim, Process * p, int cpu, int current_time) {
+  int elapsed = current_time - p->last_stop;
+  int decay = CACHE_DECAY_TIME;
+  int penalty = MIGRATION_PENALTY;
+
+  if(p->last_cpu == NO_CPU || p->last_cpu == cpu) return 0;
+  sim->stats.migrations++;
+  if(sim->cpus[p->last_cpu].node != sim->cpus[cpu].node) {
+    sim->stats.cross_node_migrations++;
+    penalty = CROSS_NODE_PENALTY;
+  }
+  else if(sim->cpus[p->last_cpu].core == sim->cpus[cpu].core) return 0; //SMT siblings share the core's caches
+  if(decay <= 0) return penalty;
+  if(elapsed >= decay) return 0; //the old cache went cold, nothing was lost by moving
+  return penalty * (decay - elapsed) / decay;
+}
+
+/**
+ * Puts a process on an idle cpu: charges the dispatch overhead and any migration penalty
+ * and records them in the stats
+ * @param  sim          the simulation
+ * @param  p            the process being dispatched
+ * @param  current_time current time
+ * @return              the time the cpu spends before the process actually starts executing
+ */
+int dispatch_process(Simulation * sim, Process * p, int current_time) {
+  int cpu = pick_cpu(sim, p);
+  int cost = DISPATCH_COST;
+  int penalty = migration_penalty(sim, p, cpu, current_time);
+  int remote;
+
+  if(p->node == NO_NODE) place_memory(sim, p, cpu);
+  p->remaining += penalty; //refilling the cache on the new cpu is extra work for the process
+  remote = remote_memory_penalty(sim, p, cpu);
+
+  sim->stats.dispatches++;
+  if(sim->cpus[cpu].last_proc != p) { // the cpu state and cache belong to someone else
+    cost += CONTEXT_SWITCH_COST + CACHE_WARMUP_COST;
+    sim->stats.context_switches++;
+  }
+  sim->cpus[cpu].proc = p;
+  sim->cpus[cpu].last_proc = p;
+  cpu_set_remove(sim->idle_cpus, cpu);
+  p->cpu = cpu;
+  sim->stats.migration_time += penalty;
+  sim->stats.overhead_time += cost;
+  sim->stats.remote_time += remote;
+  return cost + remote; //remote memory accesses stretch the burst like a delayed start
+}
+
+/**
+ * Takes a process off its cpu, remembering where and when it ran for cache affinity
+ * @param sim          the simulation
+ * @param p            the process leaving the running state
+ * @param current_time current time
+ */
+void release_cpu(Simulation * sim, Process * p, int current_time) {
+  assert(p->cpu != NO_CPU);
+  sim->cpus[p->cpu].proc = NULL;
+  cpu_set_add(sim->idle_cpus, p->cpu);
+  if(p->remaining == 0 && p->node != NO_NODE) sim->nodes[p->node].used -= p->mem; //terminated, its memory is freed
+  p->last_cpu = p->cpu;
+  p->last_stop = current_time;
+  p->cpu = NO_CPU;
+}
+
+/**
+ * Gets the histogram bucket of a latency
+ * @param  v the latency
+ * @return   the bucket
+ */
+int histogram_bucket(int v) {
+  int e;
+
+  if(v < 16) return MAX(v, 0);
+  //16 buckets per power of two, the bucket of v is within 1/16 of it
+  for(e = 0; (v >> e) >= 32; e++);
+  return 16 + e * 16 + ((v >> e) - 16);
+}
+
+/**
+ * Adds a latency to a histogram
+ * @param h the histogram
+ * @param v the latency
+ */
+void histogram_add(struct histogram * h, int v) {
+  h->count++;
+  h->buckets[histogram_bucket(v)]++;
+}
+
+/**
+ * Gets a percentile of the latencies in a histogram
+ * @param  h the histogram
+ * @param  q the percentile, between 0 and 1
+ * @return   highest latency of the bucket holding the percentile, 0 if the histogram is empty
+ */
+int histogram_percentile(struct histogram * h, double q) {
+  guint rank = (guint) (q * h->count + 0.999999), seen = 0;
+  int i, e;
+
+  if(h->count == 0) return 0;
+  for(i = 0; i < METRICS_BUCKETS - 1 && (seen += h->buckets[i]) < MAX(rank, 1); i++);
+  if(i < 16) return i;
+  e = (i - 16) / 16;
+  return (int) MIN(((gint64) (16 + (i - 16) % 16 + 1) << e) - 1, INT_MAX);
+}
+
+/**
+ * Creates the metrics output of a simulation
+ * @param  filename file the metrics are written to (overwritten)
+ * @param  window   simulated time covered by each line
+ * @return          the metrics
+ */
+struct metrics * metrics_open(const char * filename, int window) {
+  struct metrics * m = calloc(1, sizeof(struct metrics));
+
+  assert(m != NULL && window > 0);
+  m->file = fopen(filename, "w");
+  assert(m->file != NULL);
+  m->window = window;
+  fprintf(m->file, "start\tend\tthroughput\tutilization\tready avg\tready max\twait p50\twait p95\twait p99\tturnaround p50\tturnaround p95\tturnaround p99\n");
+  return m;
+}
+
+/**
+ * Writes the line of the current window and starts the next one
+ * @param sim the simulation
+ * @param end end of the current window
+ */
+void metrics_flush(Simulation * sim, int end) {
+  struct metrics * m = sim->metrics;
+  int length = end - m->window_start;
+
+  fprintf(m->file, "%d\t%d\t%d\t%.3f\t%.2f\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n", m->window_start, end, m->terminated,
+    length > 0 ? 1.0 - (double) m->idle_time / ((long long) sim->num_cpus * length) : 0.0,
+    length > 0 ? (double) m->ready_area / length : 0.0, m->ready_max,
+    histogram_percentile(&m->wait, 0.5), histogram_percentile(&m->wait, 0.95), histogram_percentile(&m->wait, 0.99),
+    histogram_percentile(&m->turnaround, 0.5), histogram_percentile(&m->turnaround, 0.95),
+    histogram_percentile(&m->turnaround, 0.99));
+  fflush(m->file); //lines come out while the simulation runs
+  m->window_start = end;
+  m->terminated = 0;
+  m->idle_time = 0;
+  m->ready_area = 0;
+  m->ready_max = g_queue_get_length(sim->ready);
+  memset(&m->wait, 0, sizeof(m->wait));
+  memset(&m->turnaround, 0, sizeof(m->turnaround));
+}
+
+/**
+ * Accounts the time between two moves in the windows it covers, writing out every window it
+ * completes. Nothing changes between moves, so the idle cpus and the ready queue length hold
+ * over the whole interval.
+ * @param sim       the simulation
+ * @param from_time time of the last move
+ * @param to_time   time of the next move
+ */
+void metrics_advance(Simulation * sim, int from_time, int to_time) {
+  struct metrics * m = sim->metrics;
+  int idle = cpu_set_count(sim->idle_cpus, sim->cpu_set_words), ready = g_queue_get_length(sim->ready);
+  gint64 window_end;
+  int until;
+
+  while(from_time < to_time) {
+    window_end = (gint64) m->window_start + m->window;
+    until = window_end < to_time ? (int) window_end : to_time;
+    m->idle_time += (long long) idle * (until - from_time);
+    m->ready_area += (long long) ready * (until - from_time);
+    if(until == window_end) metrics_flush(sim, until); //moves at the end of a window belong to the next one
+    from_time = until;
+  }
+}
+
+/**
+ * Accounts a move in the current window
+ * @param sim          the simulation
+ * @param p            the process that moved
+ * @param move         the move it made
+ * @param current_time time of the move
+ */
+void metrics_update(Simulation * sim, Process * p, int move, int current_time) {
+  struct metrics * m = sim->metrics;
+
+  if(m == NULL) return;
+  if(move == READY_TO_RUNNING) histogram_add(&m->wait, current_time - p->ready_since);
+  if(move == RUNNING_TO_TERMINATED) {
+    m->terminated++;
+    histogram_add(&m->turnaround, current_time - p->start);
+  }
+  m->ready_max = MAX(m->ready_max, (int) g_queue_get_length(sim->ready));
+}
+
+/**
+ * Writes the last, partial window and closes the metrics output
+ * @param sim the simulation
+ */
+void metrics_close(Simulation * sim) {
+  struct metrics * m = sim->metrics;
+
+  if(sim->stats.end_time > m->window_start || m->terminated > 0) metrics_flush(sim, sim->stats.end_time);
+  fclose(m->file);
+  free(m);
+  sim->metrics = NULL;
+}
+
+/**
+ * Accounts for the cpus left idle between two moves
+ * @param sim       the simulation
+ * @param from_time time of the previous move
+ * @param to_time   time of the next move
+ */
+void account_idle_cpus(Simulation * sim, int from_time, int to_time) {
+  long long idle;
+
+  if(to_time <= from_time) return;
+  idle = (long long) cpu_set_count(sim->idle_cpus, sim->cpu_set_words) * (to_time - from_time);
+  sim->stats.idle_time += idle;
+  if(!g_queue_is_empty(sim->ready)) sim->stats.waste_time += idle; //work was waiting but could not use the cpus
+  if(sim->metrics != NULL) metrics_advance(sim, from_time, to_time);
+}
+
+/**
+ * Prints the overhead stats of a finished simulation run (only when dependencies, locks, periodic
+ * tasks, admission control, overhead costs or multiple cpus are configured)
+ * @param sim  the simulation
+ * @param name name of the algorithm that was simulated
+ */
+void print_overhead_stats(Simulation * sim, const char * name) {
+  struct overhead_stats overhead = sim->stats;
+  struct dependencies * d = sim->dependencies;
+  int num_cpus = sim->num_cpus;
+
+  if(d != NULL) {
+    printf("%s dependencies: %u, critical path %lld, makespan %d (%.2f times the critical path)\n", name,
+      d->edges, (long long) d->critical_path, overhead.end_time - d->first_start,
+      d->critical_path > 0 ? (double) (overhead.end_time - d->first_start) / d->critical_path : 0.0);
+    if(d->held_count > 0) printf("%s dependencies: %u processes never released\n", name, d->held_count);
+  }
+  if(sim->locks != NULL) {
+    struct locks * k = sim->locks;
+    guint i, blocked = 0;
+
+    for(i = 0; i < k->count; i++) blocked += g_queue_get_length(k->locks[i].waiters);
+    printf("%s locks: %d acquisitions, %d contended (%.1f%%), %lld time units blocked, at most %u processes waiting on a lock\n", name,
+      k->acquisitions, k->contended, k->acquisitions > 0 ? 100.0 * k->contended / k->acquisitions : 0.0,
+      k->blocked_time, k->longest_queue);
+    if(blocked > 0) printf("%s locks: %u processes deadlocked\n", name, blocked);
+  }
+  if(sim->periodic != NULL) {
+    struct periodic * r = sim->periodic;
+
+    printf("%s periodic: %u tasks, utilization %.3f, %lld jobs released, %lld finished, %lld missed their deadline (%.1f%%), worst lateness %d\n", name,
+      r->count, r->utilization, r->released, r->finished, r->misses, r->finished > 0 ? 100.0 * r->misses / r->finished : 0.0,
+      r->worst_lateness);
+    if(r->skipped > 0) {
+      printf("%s periodic: hyperperiod %lld, the %d from time %d on extrapolated instead of simulated\n", name,
+        (long long) r->hyperperiod, r->skipped, r->skipped_from);
+    }
+  }
+  if(READY_LIMIT > 0 || TOKEN_RATE > 0) {
+    printf("%s admission: %d processes rejected, %lld of %lld units of cpu time shed (%.1f%%)\n", name,
+      overhead.rejected, overhead.rejected_work, overhead.work,
+      overhead.work > 0 ? 100.0 * overhead.rejected_work / overhead.work : 0.0);
+  }
+  if(DISPATCH_COST == 0 && CONTEXT_SWITCH_COST == 0 && CACHE_WARMUP_COST == 0 && num_cpus == 1) return;
+  printf("%s overhead: %lld dispatches, %lld context switches, %d time units of %d (%.1f%%)\n", name,
+    overhead.dispatches, overhead.context_switches, overhead.overhead_time, overhead.end_time,
+    overhead.end_time > 0 ? 100.0 * overhead.overhead_time / overhead.end_time : 0.0);
+  if(num_cpus > 1) {
+    printf("%s migrations: %lld (%lld across nodes), adding %lld time units of cpu work (%.1f%% throughput loss)\n", name,
+      overhead.migrations, overhead.cross_node_migrations, overhead.migration_time,
+      overhead.work > 0 ? 100.0 * overhead.migration_time / (overhead.work + overhead.migration_time) : 0.0);
+  }
+  if(sim->num_nodes > 1) {
+    printf("%s remote memory: cpu bursts inflated by %d time units\n", name, overhead.remote_time);
+  }
+  if(num_cpus > 1) {
+    printf("%s idle cpu time: %lld of %lld (%.1f%%), %lld while work was waiting (%.1f%% fragmentation)\n", name,
+      overhead.idle_time, (long long) num_cpus * overhead.end_time,
+      overhead.end_time > 0 ? 100.0 * overhead.idle_time / ((long long) num_cpus * overhead.end_time) : 0.0,
+      overhead.waste_time, overhead.idle_time > 0 ? 100.0 * overhead.waste_time / overhead.idle_time : 0.0);
+  }
+}
+
+/**
+ * Chains a state transition into the hash of every transition before it
+ * @param  chain hash of the transitions so far
+ * @param  time  time of the transition
+ * @param  pid   process id
+ * @param  old   old state
+ * @param  new   new state
+ * @return       the new chain
+ */
+guint64 replay_hash(guint64 chain, int time, int pid, int old, int new) {
+  guint64 x = chain ^ ((guint64) (guint32) time << 32 | (guint32) pid);
+  int i;
+
+  for(i = 0; i < 2; i++) { //splitmix64 finalizer, the second round mixes in the states
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    if(i == 0) x ^= (guint64) (old << 4 | new) * 0x9e3779b97f4a7c15ULL;
+  }
+  return x;
+}
+
+/**
+ * Creates a replay log
+ * @param  filename name of the log (overwritten)
+ * @return          the replay log
+ */
+struct replay * replay_open(const char * filename) {
+  struct replay * r = calloc(1, sizeof(struct replay));
+
+  assert(r != NULL);
+  r->file = fopen(filename, "wb");
+  assert(r->file != NULL);
+  fwrite(REPLAY_MAGIC, 1, strlen(REPLAY_MAGIC), r->file);
+  return r;
+}
+
+/**
+ * Writes the current block of a replay log and starts a new one
+ * @param r the replay log
+ */
+void replay_flush(struct replay * r) {
+  if(r->count == 0) return;
+  fwrite(&r->count, sizeof(r->count), 1, r->file);
+  fwrite(&r->first_time, sizeof(r->first_time), 1, r->file);
+  fwrite(&r->last_time, sizeof(r->last_time), 1, r->file);
+  fwrite(&r->chain, sizeof(r->chain), 1, r->file);
+  fwrite(r->hashes, sizeof(guint16), r->count, r->file);
+  r->events += r->count;
+  r->count = 0;
+}
+
+/**
+ * Adds a state transition to a replay log
+ * @param r    the replay log
+ * @param time time of the transition
+ * @param pid  process id
+ * @param old  old state
+ * @param new  new state
+ */
+void replay_record(struct replay * r, int time, int pid, int old, int new) {
+  r->chain = replay_hash(r->chain, time, pid, old, new);
+  if(r->count == 0) r->first_time = time;
+  r->last_time = time;
+  r->hashes[r->count++] = (guint16) r->chain;
+  if(r->count == REPLAY_BLOCK) replay_flush(r);
+}
+
+/**
+ * Writes what is left of a replay log and closes it
+ * @param r the replay log
+ */
+void replay_close(struct replay * r) {
+  replay_flush(r);
+  fclose(r->file);
+  free(r);
+}
+
+/**
+ * Reads the next block of a replay log
+ * @param  r the replay log being read (count is 0 at the end of the log)
+ * @return   FALSE if the log is truncated
+ */
+gboolean replay_read_block(struct replay * r) {
+  r->events += r->count;
+  if(fread(&r->count, sizeof(r->count), 1, r->file) != 1) {
+    r->count = 0;
+    return feof(r->file);
+  }
+  return r->count <= REPLAY_BLOCK
+    && fread(&r->first_time, sizeof(r->first_time), 1, r->file) == 1
+    && fread(&r->last_time, sizeof(r->last_time), 1, r->file) == 1
+    && fread(&r->chain, sizeof(r->chain), 1, r->file) == 1
+    && fread(r->hashes, sizeof(guint16), r->count, r->file) == r->count;
+}
+
+/**
+ * Compares the replay logs of two runs and reports the first event where they diverge
+ * @param  a name of the first log
+ * @param  b name of the second log
+ * @return   exit status: 0 if the runs are identical, 1 if they diverge, 2 on invalid logs
+ */
+int replay_check(const char * a, const char * b) {
+  struct replay * ra = calloc(1, sizeof(struct replay));
+  struct replay * rb = calloc(1, sizeof(struct replay));
+  char magic[sizeof(REPLAY_MAGIC)] = "";
+  const char * bad;
+  guint32 i, n;
+  int status = -1;
+
+  assert(ra != NULL && rb != NULL);
+  ra->file = fopen(a, "rb");
+  rb->file = fopen(b, "rb");
+  if(ra->file == NULL || fread(magic, 1, strlen(REPLAY_MAGIC), ra->file) != strlen(REPLAY_MAGIC)
+      || strcmp(magic, REPLAY_MAGIC) != 0) {
+    printf("%s is not a replay log\n", a);
+    status = 2;
+  }
+  else if(rb->file == NULL || fread(magic, 1, strlen(REPLAY_MAGIC), rb->file) != strlen(REPLAY_MAGIC)
+      || strcmp(magic, REPLAY_MAGIC) != 0) {
+    printf("%s is not a replay log\n", b);
+    status = 2;
+  }
+  else while(status == -1) {
+    bad = !replay_read_block(ra) ? a : !replay_read_block(rb) ? b : NULL;
+    if(bad != NULL) {
+      printf("%s is truncated\n", bad);
+      status = 2;
+    }
+    else if(ra->count == 0 && rb->count == 0) {
+      printf("Runs are identical: %llu events, chain %016llx\n", (unsigned long long) ra->events,
+        (unsigned long long) ra->chain);
+      status = 0;
+    }
+    else if(ra->count != rb->count || ra->chain != rb->chain) {
+      //the chains stay different once they diverged, the first differing bits give the event
+      n = MIN(ra->count, rb->count);
+      for(i = 0; i < n && ra->hashes[i] == rb->hashes[i]; i++);
+      if(i == n && ra->count != rb->count) {
+        printf("Runs diverge at event %llu: %s ends there\n", (unsigned long long) (ra->events + n),
+          ra->count < rb->count ? a : b);
+      }
+      else printf("Runs diverge at event %llu (between time %d and %d in %s, %d and %d in %s)\n",
+        (unsigned long long) (ra->events + i), ra->first_time, ra->last_time, a, rb->first_time, rb->last_time, b);
+      status = 1;
+    }
+  }
+  if(ra->file != NULL) fclose(ra->file);
+  if(rb->file != NULL) fclose(rb->file);
+  free(ra);
+  free(rb);
+  return status;
+}
+
+/**
+ * moves a process from the head of a non-empty queue to the tail of another queue
+ * @param from SOURCE queue
+ * @param to   DESTINATION queue
+ */
+void move_process(GQueue * from, GQueue * to) {
+  assert(!g_queue_is_empty(from)); //from cannot be empty
+  g_queue_push_tail(to, g_queue_pop_head(from));
+}
+
+/**
+ * moves an element of a queue to its head, so that it is the next one moved by move_process()
+ * @param q    the queue
+ * @param link the element to move
+ */
+void move_to_head(GQueue * q, GList * link) {
+  if(link == q->head) return;
+  g_queue_unlink(q, link);
+  g_queue_push_head_link(q, link);
+}
+
+/**
+ * gets the start value of the process in a queue
+ * @param  q the queue to do the operation on
+ * @return   the start value of the process in a queue
+ */
+int get_head_start_val(GQueue * q) {
+  return ((Process *) g_queue_peek_head(q))->start;
+}
+
+/**
+ * Return the pid of the tail of the queue
+ * @param  q the queue to do the operation on
+ * @return   the pid of the tail of the queue
+ */
+int get_tail_pid(GQueue * q) {
+  return ((Process *) g_queue_peek_tail(q))->pid;
+}
+
+/**
+ * Get the IO duration of the tail of the queue
+ * @param  q the queue to do the operation on
+ * @return   the IO duration of the tail of the queue
+ */
+int get_tail_iodur(GQueue * q) {
+  return burst_io((Process *) g_queue_peek_tail(q));
+}
+
+/**
+ * Get the IO duration of the head of the queue
+ * @param  q the queue to do the operation on
+ * @return   the IO duration of the head of the queue
+ */
+int get_head_iodur(GQueue * q) {
+  return burst_io((Process *) g_queue_peek_head(q));
+}
+
+/**
+ * Get the IO frequency of the head of the queue
+ * @param  q the queue to do the operation on
+ * @return   the IO frequency of the head of the queue
+ */
+int get_head_iofreq_val(GQueue * q) {
+  return burst_cpu((Process *) g_queue_peek_head(q));
+}
+
+/**
+ * Get the IO frequency of the tail of the queue
+ * @param  q the queue to do the operation on
+ * @return   the IO frequency of the tail of the queue
+ */
+int get_tail_iofreq_val(GQueue * q) {
+  return burst_cpu((Process *) g_queue_peek_tail(q));
+}
+
+/**
+ * Get the next IO time of the head of the queue
+ * @param  q            the queue
+ * @param  current_time current time
+ * @return              the next IO time of the head of the queue
+ */
+int get_next_io_time(GQueue * q, int current_time) {
+  return get_head_last_start(q) + get_head_iofreq_val(q);
+}
+
+/**
+ * Get the remaining cpu time of the tail of the queue
+ * @param  q the queue to do the operation on
+ * @return   the remaining cpu time of the tail of the queue
+ */
+int get_tail_remaining_time(GQueue * q) {
+  Process * proc = (Process *) g_queue_peek_tail(q);
+  return proc->remaining;
+}
+
+/**
+ * Get the remaining cpu time of the head of the queue
+ * @param  q the queue to do the operation on
+ * @return   the remaining cpu time of the head of the queue
+ */
+int get_head_remaining_time(GQueue * q) {
+  Process * proc = (Process *) g_queue_peek_head(q);
+  return proc->remaining;
+}
+
+/**
+ * Get the Round Robin frequency for the head of the queue
+ * @param  q the queue
+ * @return   the Round Robin frequency for the head of the queue
+ */
+int get_head_rr_freq(GQueue * q) {
+  Process * proc = (Process *) g_queue_peek_head(q);
+  return proc->tmpl->rr;
+}
+
+/**
+ * Get the Round Robin frequency for the head of the queue
+ * @param  q the queue
+ * @return   the Round Robin frequency for the head of the queue
+ */
+int get_tail_rr_freq(GQueue * q) {
+  Process * proc = (Process *) g_queue_peek_tail(q);
+  return proc->tmpl->rr;
+}
+
+/**
+ * Set the remaining time on the tail process of the queue
+ * @param q   the queue
+ * @param val the new remaining time value
+ */
+void set_tail_remaining_time(GQueue * q, int val) {
+  Process * proc = (Process *) g_queue_peek_tail(q);
+  proc->remaining = val;
+}
+
+/**
+ * Set the remaining time on the head process of the queue
+ * @param q   the queue
+ * @param val the new remaining time value
+ */
+void set_head_last_start(GQueue * q, int val) {
+  Process * proc = (Process *) g_queue_peek_head(q);
+  proc->last_start = val;
+}
+
+/**
+ * Set the last start time on the tail process of the queue
+ * @param q   the queue
+ * @param val the new last start time value
+ */
+void set_tail_last_start(GQueue * q, int val) {
+  Process * proc = (Process *) g_queue_peek_tail(q);
+  proc->last_start = val;
+}
+
+/**
+ * Get the last start time of the head process of the queue
+ * @param  q the queue to do the operation on
+ * @return   the value of the last start
+ */
+int get_head_last_start(GQueue * q) {
+  Process * proc = (Process *) g_queue_peek_head(q);
+  return proc->last_start;
+}
+
+/**
+ * Get the last start time of the tail process of the queue
+ * @param  q the queue to do the operation on
+ * @return   the value of the last start
+ */
+int get_tail_last_start(GQueue * q) {
+  Process * proc = (Process *) g_queue_peek_tail(q);
+  return proc->last_start;
+}
+
+/**
+ * Set the IO last start on the tail process of the queue
+ * @param q   the queue
+ * @param val the new IO last start time
+ */
+void set_tail_io_start(GQueue * q, int val) {
+  Process * proc = (Process *) g_queue_peek_tail(q);
+  proc->last_io_start = val;
+}
+
+/**
+ * Get the IO last start on the tail process of the queue
+ * @param q   the queue
+ * @param val the new IO last start time
+ */
+int get_tail_last_io_start(GQueue * q) {
+  Process * proc = (Process *) g_queue_peek_tail(q);
+  return proc->last_io_start;
+}
+
+/*
+ * Get the IO last start on the head process of the queue
+ * @param q   the queue
+ * @param val the new IO last start time
+ */
+int get_head_last_io_start(GQueue * q) {
+  Process * proc = (Process *) g_queue_peek_head(q);
+  return proc->last_io_start;
+}
+
+/**
+ * Groups the processes of a simulation that share a job id into gangs
+ * @param sim the simulation, with all its processes in the all queue
+ */
+void setup_gangs(Simulation * sim) {
+  GList * link;
+  struct gang * g;
+  GHashTable * gangs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free);
+
+  sim->gangs = gangs;
+  for(link = sim->all->head; link != NULL; link = link->next) {
+    Process * p = (Process *) link->data;
+    if(p->job == NO_JOB) continue;
+    g = g_hash_table_lookup(gangs, GINT_TO_POINTER(p->job));
+    if(g == NULL) {
+      g = calloc(1, sizeof(struct gang));
+      assert(g != NULL);
+      g->job = p->job;
+      g_hash_table_insert(gangs, GINT_TO_POINTER(p->job), g);
+    }
+    g->live++;
+    p->gang = g;
+  }
+}
+
+/**
+ * Keeps a gang's member counts up to date after one of its members moved
+ * @param sim  the simulation
+ * @param p    the process that moved
+ * @param move the move it made
+ */
+void update_gang(Simulation * sim, Process * p, int move) {
+  struct gang * g = p->gang;
+
+  if(g == NULL) return;
+  switch(move) {
+    case NEW_TO_READY:
+    case WAITING_TO_READY:
+    case RUNNING_TO_READY:
+    case BLOCKED_TO_READY:
+      g->ready++;
+      break;
+
+    case READY_TO_RUNNING:
+      g->ready--;
+      g->dispatching = g->ready > 0 && cpu_set_count(sim->idle_cpus, sim->cpu_set_words) > 0; //all members go on cpus together
+      break;
+
+    case RUNNING_TO_TERMINATED:
+      g->live--;
+      break;
+  }
+}
+
+/**
+ * Gets where a process is in its lock script
+ * @param  sim the simulation
+ * @param  p   the process
+ * @return     the lock state, NULL if the process has no lock script
+ */
+struct lock_state * lock_state(Simulation * sim, Process * p) {
+  return sim->locks != NULL ? g_hash_table_lookup(sim->locks->scripts, p) : NULL;
+}
+
+/**
+ * Tells if the ready queue of a simulation is ordered by the heap
+ * @param  sim the simulation
+ * @return     TRUE for SJF, SRTF, RM and EDF on ENGINE_HEAP
+ */
+gboolean ready_heap_used(Simulation * sim) {
+  return sim->engine == ENGINE_HEAP && (sim->sort == SJF_SORT || sim->sort == SRTF_SORT || sim->sort == RM_SORT || sim->sort == EDF_SORT);
+}
+
+/**
+ * Compares two entries of a heap ordered ready queue
+ * @param  a first entry
+ * @param  b second entry
+ * @return   TRUE if a comes before b
+ */
+gboolean ready_entry_less(struct ready_entry * a, struct ready_entry * b) {
+  return a->key < b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+/**
+ * Puts an entry at a position of the heap ordering the ready queue
+ * @param heap the heap
+ * @param i    the position
+ * @param e    the entry
+ */
+void ready_heap_set(GArray * heap, guint i, const struct ready_entry * e) {
+  g_array_index(heap, struct ready_entry, i) = *e;
+  if(e->lock != NULL) e->lock->position = i;
+}
+
+/**
+ * Adds the process that just became ready to the heap
+ * @param sim  the simulation
+ * @param link element of the process in the ready queue
+ * @param key  sort key of the process
+ */
+void ready_heap_push(Simulation * sim, GList * link, int key) {
+  GArray * heap = sim->ready_heap;
+  struct ready_entry e = { key, sim->ready_seq++, link, PRIORITY_INHERITANCE ? lock_state(sim, link->data) : NULL };
+  guint i = heap->len, parent;
+
+  g_array_set_size(heap, heap->len + 1);
+  for(; i > 0; i = parent) { //sift up
+    parent = (i - 1) / 2;
+    if(!ready_entry_less(&e, &g_array_index(heap, struct ready_entry, parent))) break;
+    ready_heap_set(heap, i, &g_array_index(heap, struct ready_entry, parent));
+  }
+  ready_heap_set(heap, i, &e);
+}
+
+/**
+ * Removes the first process from the heap, once it has been dispatched
+ * @param sim the simulation
+ */
+void ready_heap_pop(Simulation * sim) {
+  GArray * heap = sim->ready_heap;
+  struct ready_entry e;
+  guint i = 0, child, n;
+
+  assert(heap->len > 0);
+  if(g_array_index(heap, struct ready_entry, 0).lock != NULL) g_array_index(heap, struct ready_entry, 0).lock->position = NO_POSITION;
+  n = heap->len - 1;
+  e = g_array_index(heap, struct ready_entry, n);
+  for(; (child = 2 * i + 1) < n; i = child) { //sift the last entry down from the root
+    if(child + 1 < n && ready_entry_less(&g_array_index(heap, struct ready_entry, child + 1),
+        &g_array_index(heap, struct ready_entry, child))) child++;
+    if(!ready_entry_less(&g_array_index(heap, struct ready_entry, child), &e)) break;
+    ready_heap_set(heap, i, &g_array_index(heap, struct ready_entry, child));
+  }
+  if(n > 0) ready_heap_set(heap, i, &e);
+  g_array_set_size(heap, n);
+}
+
+/**
+ * Gets the ready process that comes first in the order of the scheduling algorithm
+ * @param  sim the simulation
+ * @return     its element in the ready queue, NULL if the ready queue is empty
+ */
+GList * ready_head(Simulation * sim) {
+  if(ready_heap_used(sim)) return sim->ready_heap->len > 0 ? g_array_index(sim->ready_heap, struct ready_entry, 0).link : NULL;
+  return sim->ready->head;
+}
+
+/**
+ * Compares two timers of the same kind
+ * @param  a first timer
+ * @param  b second timer
+ * @return   TRUE if a happens before b
+ */
+gboolean timer_less(struct timer * a, struct timer * b) {
+  return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+/**
+ * Puts a timer at a position of its heap and tells its process where it is
+ * @param heap the timer heap
+ * @param kind kind of the timers in the heap
+ * @param i    the position
+ * @param t    the timer
+ */
+void timer_place(GArray * heap, int kind, guint i, struct timer t) {
+  g_array_index(heap, struct timer, i) = t;
+  t.p->timer[kind] = i;
+}
+
+/**
+ * Restores the heap order around a timer that was put at a position
+ * @param heap the timer heap
+ * @param kind kind of the timers in the heap
+ * @param i    the position
+ */
+void timer_sift(GArray * heap, int kind, guint i) {
+  struct timer t = g_array_index(heap, struct timer, i);
+  guint parent, child;
+
+  while(i > 0 && timer_less(&t, &g_array_index(heap, struct timer, (parent = (i - 1) / 2)))) {
+    timer_place(heap, kind, i, g_array_index(heap, struct timer, parent));
+    i = parent;
+  }
+  while((child = 2 * i + 1) < heap->len) {
+    if(child + 1 < heap->len && timer_less(&g_array_index(heap, struct timer, child + 1),
+        &g_array_index(heap, struct timer, child))) child++;
+    if(!timer_less(&g_array_index(heap, struct timer, child), &t)) break;
+    timer_place(heap, kind, i, g_array_index(heap, struct timer, child));
+    i = child;
+  }
+  timer_place(heap, kind, i, t);
+}
+
+/**
+ * Sets a timer for a process that just entered the running or waiting queue
+ * @param sim   the simulation
+ * @param kind  kind of timer
+ * @param p     the process
+ * @param link  element of the process in its queue
+ * @param from  time the delay starts at
+ * @param delay time until the event (additions past INT_MAX never happen)
+ */
+void timer_add(Simulation * sim, int kind, Process * p, GList * link, int from, int delay) {
+  GArray * heap = sim->timers[kind];
+  gint64 time = (gint64) from + delay;
+  struct timer t = { time > INT_MAX ? INT_MAX : (int) time, sim->timer_seq, p, link };
+
+  assert(p->timer[kind] == NO_TIMER);
+  g_array_append_val(heap, t);
+  timer_sift(heap, kind, heap->len - 1);
+}
+
+/**
+ * Cancels a pending timer of a process, if it has one
+ * @param sim  the simulation
+ * @param kind kind of timer
+ * @param p    the process
+ */
+void timer_cancel(Simulation * sim, int kind, Process * p) {
+  GArray * heap = sim->timers[kind];
+  int i = p->timer[kind];
+  guint last = heap->len - 1;
+
+  if(i == NO_TIMER) return;
+  p->timer[kind] = NO_TIMER;
+  if((guint) i != last) { //the last timer fills the hole and moves up or down from there
+    timer_place(heap, kind, i, g_array_index(heap, struct timer, last));
+    g_array_set_size(heap, last);
+    timer_sift(heap, kind, i);
+  }
+  else g_array_set_size(heap, last);
+}
+
+/**
+ * Gets the soonest timer of a kind
+ * @param  sim  the simulation
+ * @param  kind kind of timer
+ * @param  link set to the element of the timer's process in its queue
+ * @return      time of the timer, INT_MAX if there is none
+ */
+int timer_next(Simulation * sim, int kind, GList ** link) {
+  GArray * heap = sim->timers[kind];
+
+  if(heap->len == 0) return INT_MAX;
+  *link = g_array_index(heap, struct timer, 0).link;
+  return g_array_index(heap, struct timer, 0).time;
+}
+
+/**
+ * Keeps the timers of a process up to date after it moved (ENGINE_HEAP only)
+ * @param sim  the simulation
+ * @param p    the process that moved
+ * @param move the move it made
+ * @param link element of the process in its new queue
+ */
+void update_timers(Simulation * sim, Process * p, int move, GList * link) {
+  if(sim->engine != ENGINE_HEAP) return;
+  switch(move) {
+    case READY_TO_RUNNING:
+      sim->timer_seq++;
+      timer_add(sim, TIMER_SLICE, p, link, p->last_start, p->tmpl->rr);
+      timer_add(sim, TIMER_IO, p, link, p->last_start, burst_cpu(p));
+      timer_add(sim, TIMER_TERMINATE, p, link, p->last_start, p->remaining);
+      break;
+
+    case RUNNING_TO_TERMINATED:
+    case RUNNING_TO_WAITING:
+    case RUNNING_TO_READY:
+    case RUNNING_TO_BLOCKED: //whichever event took the process off its cpu, the others will not happen
+      timer_cancel(sim, TIMER_SLICE, p);
+      timer_cancel(sim, TIMER_IO, p);
+      timer_cancel(sim, TIMER_TERMINATE, p);
+      if(move == RUNNING_TO_WAITING) {
+        sim->timer_seq++;
+        timer_add(sim, TIMER_IO_DONE, p, link, p->last_io_start, burst_io(p));
+      }
+      break;
+
+    case WAITING_TO_READY:
+      timer_cancel(sim, TIMER_IO_DONE, p);
+      break;
+  }
+}
+
+/**
+ * Picks the ready process to dispatch next. Gang scheduling dispatches a gang only once all
+ * of its live members are ready and enough cpus are idle to run them all at once (or all cpus
+ * for a gang larger than the machine), then puts the other members on cpus at the same time.
+ * Without GANG_BACKFILL a gang that does not fit blocks the processes behind it.
+ * @param  sim the simulation
+ * @return     the element of the ready queue to dispatch, NULL if nothing can be dispatched
+ */
+GList * pick_ready(Simulation * sim) {
+  GList * link;
+  GQueue * ready = sim->ready;
+  int idle, num_cpus = sim->num_cpus;
+
+  if(sim->sort != GANG_SORT) return ready_head(sim);
+
+  idle = cpu_set_count(sim->idle_cpus, sim->cpu_set_words);
+  for(link = ready->head; link != NULL; link = link->next) { //members of a gang being dispatched go first
+    Process * p = (Process *) link->data;
+    if(p->gang != NULL && p->gang->dispatching) return link;
+  }
+  for(link = ready->head; link != NULL; link = link->next) {
+    Process * p = (Process *) link->data;
+    if(p->gang == NULL) return link;
+    if(p->gang->ready == p->gang->live && idle >= MIN(p->gang->live, num_cpus)) return link;
+    if(!GANG_BACKFILL) return NULL;
+  }
+  return NULL;
+}
+
+/**
+ * Records a state transition in the outputs that keep every transition even when the traces
+ * hold REPEAT records: the collected events and the replay log
+ * @param sim  the simulation
+ * @param time time of the transition
+ * @param pid  process id
+ * @param old  old state
+ * @param new  new state
+ */
+void record_event(Simulation * sim, int time, int pid, int old, int new) {
+  if(sim->events != NULL) {
+    TraceEvent e = { time, pid, old, new };
+    g_array_append_val(sim->events, e);
+  }
+  if(sim->replay != NULL) replay_record(sim->replay, time, pid, old, new);
+  if(sim->periodic != NULL && sim->periodic->window >= 0) { //collecting a hyperperiod
+    TraceEvent e = { time, pid, old, new };
+    g_array_append_val(sim->periodic->events, e);
+  }
+}
+
+/**
+ * Records a state transition of a process in the simulation's trace
+ * @param sim  the simulation
+ * @param time time of the transition
+ * @param pid  process id
+ * @param old  old state
+ * @param new  new state
+ */
+void record_move(Simulation * sim, int time, int pid, int old, int new) {
+  int bytes;
+
+  if(sim->trace != NULL) {
+    bytes = write_update(sim->trace, time, pid, old, new);
+    if(sim->trace_index != NULL) trace_index_add(sim->trace_index, time, time, pid, bytes);
+  }
+  if(sim->ztrace != NULL) trace_writer_add(sim->ztrace, time, pid, old, new);
+  record_event(sim, time, pid, old, new);
+}
+
+/**
+ * Records the cycles of a process that was fast-forwarded, in time linear in the cycles only when
+ * an output needs every transition
+ * @param sim    the simulation
+ * @param cycle  transitions of the first cycle
+ * @param lines  number of transitions in a cycle
+ * @param count  number of cycles
+ * @param period time between the cycles
+ */
+void record_cycles(Simulation * sim, const TraceEvent * cycle, int lines, int count, int period) {
+  char line[MAX_LINE];
+  GHashTable * pids;
+  int i, k, bytes, time, last_time = cycle[lines - 1].time + (count - 1) * period;
+  //with REPEAT records the other cycles only go to the outputs that keep every transition, if any
+  int recorded = FAST_FORWARD != FAST_FORWARD_REPEAT || sim->events != NULL || sim->replay != NULL
+    || (sim->periodic != NULL && sim->periodic->window >= 0) ? count : 1;
+
+  for(k = 0; k < recorded; k++) {
+    for(i = 0; i < lines; i++) {
+      time = cycle[i].time + k * period;
+      if(k == 0 || FAST_FORWARD != FAST_FORWARD_REPEAT) record_move(sim, time, cycle[i].pid, cycle[i].old_state, cycle[i].new_state);
+      else record_event(sim, time, cycle[i].pid, cycle[i].old_state, cycle[i].new_state);
+    }
+  }
+  if(FAST_FORWARD != FAST_FORWARD_REPEAT || count < 2) return;
+
+  time = cycle[0].time + period;
+  bytes = snprintf(line, sizeof(line), TRACE_REPEAT_FORMAT, time, cycle[0].pid, lines, count - 1, period);
+  if(sim->trace != NULL) {
+    fputs(line, sim->trace);
+    if(sim->trace_index != NULL) {
+      //the record stands for the lines of every pid in the cycle, so pid queries find it
+      trace_index_add(sim->trace_index, time, last_time, cycle[0].pid, bytes);
+      pids = g_hash_table_new(g_direct_hash, g_direct_equal);
+      g_hash_table_insert(pids, GINT_TO_POINTER(cycle[0].pid), GINT_TO_POINTER(TRUE));
+      for(i = 1; i < lines; i++) {
+        if(g_hash_table_lookup(pids, GINT_TO_POINTER(cycle[i].pid)) != NULL) continue;
+        g_hash_table_insert(pids, GINT_TO_POINTER(cycle[i].pid), GINT_TO_POINTER(TRUE));
+        trace_index_pid(sim->trace_index, cycle[i].pid, bytes);
+      }
+      g_hash_table_destroy(pids);
+    }
+  }
+  if(sim->ztrace != NULL) trace_writer_line(sim->ztrace, time, last_time, line);
+}
+
+/**
+ * Reads the next process of a streamed run, into the slot of a terminated process if there is one
+ * @param  sim the simulation
+ * @return     element holding the process, NULL at the end of the data, at the first invalid
+ *             line or at the first process arriving before the ones already read (failed)
+ */
+GList * source_read(Simulation * sim) {
+  struct process_source * src = sim->source;
+  char line[MAX_LINE];
+  GList * link;
+  Process * p;
+  int fields;
+
+  if((link = sim->free_slots) != NULL) sim->free_slots = link->next;
+  else {
+    link = g_list_alloc();
+    link->data = malloc(sizeof(Process));
+    assert(link->data != NULL);
+    sim->slots++;
+  }
+  link->next = link->prev = NULL;
+  while(fgets(line, sizeof(line), src->file) != NULL) {
+    p = link->data;
+    fields = parse_process(line, src->templates, &p);
+    if(fields == EOF || fields == RECORD_TEMPLATE) continue; //blank line or template
+    if(fields < 6 || p->start < src->last_start) {
+      src->failed = TRUE;
+      break;
+    }
+    return link;
+  }
+  link->next = sim->free_slots;
+  sim->free_slots = link;
+  return NULL;
+}
+
+/**
+ * Starts streaming the processes of a simulation from text input data
+ * @param sim the simulation, with an empty all queue
+ * @param fp  the text input data, closed by simulation_free()
+ */
+void source_open(Simulation * sim, FILE * fp) {
+  struct process_source * src;
+
+  src = calloc(1, sizeof(struct process_source));
+  assert(src != NULL);
+  src->file = fp;
+  src->templates = g_hash_table_new(g_direct_hash, g_direct_equal);
+  sim->source = src;
+  src->next = source_read(sim);
+}
+
+/**
+ * Moves the processes of the next arrival time of a streamed run to its all queue. Processes
+ * arriving together go in reverse order, the order parse_file() and the stable sort of
+ * simulation_new() leave them in.
+ * @param sim the simulation, with an empty all queue
+ */
+void source_refill(Simulation * sim) {
+  struct process_source * src = sim->source;
+  GList * link = src->next;
+
+  if(link == NULL) return;
+  src->last_start = ((Process *) link->data)->start;
+  do g_queue_push_head_link(sim->all, link);
+  while((link = source_read(sim)) != NULL && ((Process *) link->data)->start == src->last_start);
+  src->next = link;
+}
+
+/**
+ * Moves a process that is done with in a streamed run or a run with periodic tasks to the free
+ * slots: one that terminated, once its summary has gone to on_terminate, or one that was rejected.
+ * The cpus forget it as their last process, since another process will take its address.
+ * @param sim   the simulation
+ * @param queue queue holding the process
+ * @param link  its element in the queue
+ */
+void process_recycle(Simulation * sim, GQueue * queue, GList * link) {
+  int i;
+
+  for(i = 0; i < sim->num_cpus; i++) { //the next process in the slot is not the one whose state the cpu holds
+    if(sim->cpus[i].last_proc == link->data) sim->cpus[i].last_proc = NULL;
+  }
+  g_queue_unlink(queue, link);
+  link->prev = NULL;
+  link->next = sim->free_slots;
+  sim->free_slots = link;
+}
+
+/**
+ * Stops streaming: closes the input and frees the free slots
+ * @param sim the simulation
+ */
+void source_close(Simulation * sim) {
+  struct process_source * src = sim->source;
+  GList * link;
+
+  if(src->next != NULL) {
+    src->next->next = sim->free_slots;
+    sim->free_slots = src->next;
+  }
+  while((link = sim->free_slots) != NULL) {
+    sim->free_slots = link->next;
+    free(link->data);
+    g_list_free_1(link);
+  }
+  g_hash_table_destroy(src->templates);
+  fclose(src->file);
+  free(src);
+  sim->source = NULL;
+}
+
+/**
+ * Gets the sort key a process inherited from the processes blocked on its mutexes
+ * @param  sim the simulation
+ * @param  p   the process
+ * @return     the key, NO_BOOST without PRIORITY_INHERITANCE or if it inherited none
+ */
+int lock_boost(Simulation * sim, Process * p) {
+  struct lock_state * s;
+
+  if(!PRIORITY_INHERITANCE || (s = lock_state(sim, p)) == NULL) return NO_BOOST;
+  return s->boost;
+}
+
+/**
+ * Gets the key the scheduling algorithm orders a ready process by
+ * @param  sim the simulation
+ * @param  p   the process
+ * @return     total for SJF, remaining for SRTF (or the key it inherited if lower), the period
+ *             of its task for RM, its absolute deadline for EDF (INT_MAX for processes that are
+ *             not jobs of a periodic task: they only get the cpu no job wants), 0 otherwise
+ *             (queue order)
+ */
+int ready_key(Simulation * sim, Process * p) {
+  if(sim->sort == SJF_SORT) return MIN(p->tmpl->total, lock_boost(sim, p));
+  if(sim->sort == SRTF_SORT) return MIN(p->remaining, lock_boost(sim, p));
+  if(sim->sort == RM_SORT) return p->tmpl->period > 0 ? p->tmpl->period : INT_MAX;
+  if(sim->sort == EDF_SORT) return p->tmpl->deadline > 0 ? (int) MIN((gint64) p->start + p->tmpl->deadline, INT_MAX) : INT_MAX;
+  return 0;
+}
+
+/**
+ * Compares 2 ready processes by the key the scheduling algorithm orders them by, inherited
+ * keys included
+ * @param  a    First process
+ * @param  b    Second process
+ * @param  data the simulation
+ * @return      a negative value if a < b, 0 if a = b, a positive value if a > b
+ */
+gint sort_ready_key(gconstpointer a, gconstpointer b, gpointer data) {
+  return ready_key((Simulation *) data, (Process *) a) - ready_key((Simulation *) data, (Process *) b);
+}
+
+/**
+ * Gets the periodic task a process is a job of
+ * @param  r the periodic tasks of the simulation
+ * @param  p the process
+ * @return   the task, NULL if the process is not a job of one
+ */
+struct periodic_task * periodic_task(struct periodic * r, Process * p) {
+  guint i;
+
+  if(p->tmpl->period == 0) return NULL;
+  i = GPOINTER_TO_UINT(g_hash_table_lookup(r->by_pid, GINT_TO_POINTER(p->pid)));
+  return i > 0 ? &r->tasks[i - 1] : NULL;
+}
+
+/**
+ * Counts a terminated job of a periodic task, and whether it met its deadline
+ * @param r the periodic tasks of the simulation
+ * @param p the process that terminated
+ */
+void periodic_finish(struct periodic * r, Process * p) {
+  int lateness;
+
+  if(periodic_task(r, p) == NULL) return;
+  r->finished++;
+  lateness = p->finish - p->start - p->tmpl->deadline;
+  if(lateness > 0) {
+    r->misses++;
+    r->worst_lateness = MAX(r->worst_lateness, lateness);
+  }
+}
+
+/**
+ * Moves a process from one state to another. The state transitions are determined by the 'move' paramater.
+ * new/all --> ready; ready --> runninig; running --> terminated; running --> waiting; waiting --> ready; waiting --> ready; running --> ready.
+ *
+ * @param sim
+ * @param from
+ * @param to
+ * @param move
+ * @param current_time
+ */
+void execute_move(Simulation * sim, GQueue * from, GQueue * to, int move, int current_time) {
+  gboolean must_sort = FALSE;
+  Process * p;
+
+  move_process(from, to);
+  p = (Process *) g_queue_peek_tail(to);
+  sim->stats.end_time = current_time;
+
+  switch(move) {
+    case NEW_TO_READY: // all --> ready
+      must_sort = TRUE;
+      p->ready_since = current_time;
+      sim->stats.work += p->tmpl->total;
+      record_move(sim, current_time, p->pid, NEW_STATE, READY_STATE);
+      break;
+
+    case READY_TO_RUNNING: // ready --> running
+      if(ready_heap_used(sim)) ready_heap_pop(sim); //the dispatched process is always the first of the heap
+      p->wait_time += current_time - p->ready_since;
+      // the process starts executing once the dispatch overhead has been paid
+      set_tail_last_start(to, current_time + dispatch_process(sim, p, current_time));
+      record_move(sim, current_time, p->pid, READY_STATE, RUNNING_STATE);
+      break;
+
+    case RUNNING_TO_TERMINATED: // running --> terminated
+      set_tail_remaining_time(to, 0);
+      release_cpu(sim, p, current_time);
+      p->finish = current_time;
+      record_move(sim, current_time, p->pid, RUNNING_STATE, TERMINATED_STATE);
+      if(sim->periodic != NULL) periodic_finish(sim->periodic, p);
+      if(sim->on_terminate != NULL) sim->on_terminate(sim, p, sim->data);
+      break;
+
+    case RUNNING_TO_WAITING: // running --> waiting
+      release_cpu(sim, p, current_time);
+      set_tail_remaining_time(to, get_tail_remaining_time(to)-get_tail_iofreq_val(to));
+      set_tail_io_start(to, current_time);
+      record_move(sim, current_time, p->pid, RUNNING_STATE, WAITING_STATE);
+      break;
+
+    case WAITING_TO_READY: // waiting --> ready
+      must_sort = TRUE;
+      p->ready_since = current_time;
+      burst_next(p);
+      record_move(sim, current_time, p->pid, WAITING_STATE, READY_STATE);
+      break;
+
+    case RUNNING_TO_READY: // running --> ready
+      must_sort = TRUE;
+      p->ready_since = current_time;
+      release_cpu(sim, p, current_time);
+      //the time slice ran out, or with SRTF_PREEMPT the process was preempted before that
+      set_tail_remaining_time(to, get_tail_remaining_time(to) - MAX(0, current_time - p->last_start));
+      record_move(sim, current_time, p->pid, RUNNING_STATE, READY_STATE);
+      break;
+
+    case RUNNING_TO_BLOCKED: // running --> wait queue of a lock
+      release_cpu(sim, p, current_time);
+      set_tail_remaining_time(to, get_tail_remaining_time(to) - MAX(0, current_time - p->last_start));
+      record_move(sim, current_time, p->pid, RUNNING_STATE, BLOCKED_STATE);
+      break;
+
+    case BLOCKED_TO_READY: // wait queue of a lock --> ready
+      must_sort = TRUE;
+      p->ready_since = current_time;
+      record_move(sim, current_time, p->pid, BLOCKED_STATE, READY_STATE);
+      break;
+
+    default:
+      return;
+      break;
+  }
+
+  update_gang(sim, p, move);
+  update_timers(sim, p, move, to->tail);
+  metrics_update(sim, p, move, current_time);
+  if(move == RUNNING_TO_TERMINATED && (sim->source != NULL || sim->periodic != NULL)) process_recycle(sim, to, to->tail);
+
+  if(must_sort) {
+    if(ready_heap_used(sim)) ready_heap_push(sim, to->tail, ready_key(sim, p));
+    else if(PRIORITY_INHERITANCE && sim->locks != NULL && (sim->sort == SJF_SORT || sim->sort == SRTF_SORT)) g_queue_sort(to, sort_ready_key, sim);
+    else if(sim->sort == SJF_SORT) g_queue_sort(to, sjf_algorithm, NULL);
+    else if(sim->sort == SRTF_SORT) g_queue_sort(to, srtf_algorithm, NULL);
+    else if(sim->sort == RM_SORT || sim->sort == EDF_SORT) g_queue_sort(to, sort_ready_key, sim);
+  }
+}
+
+/**
+ * Fast-forwards a process running alone through the cycles it repeats until the next arrival:
+ * running until its I/O, waiting for it and going straight back on the cpu, or running for a
+ * time slice and going straight back on the cpu. Nothing else can happen during these cycles, so
+ * they are made in one step. Only with one cpu, no dispatch costs and no gang scheduling, locks,
+ * burst programs or streaming metrics, where every cycle is the same.
+ * @param  sim          the simulation
+ * @param  current_time time of the last move
+ * @return              time of the last move made, INVALID_MOVE if there was nothing to fast-forward
+ */
+int fast_forward(Simulation * sim, int current_time) {
+  TraceEvent cycle[3];
+  GList * link = sim->running->head;
+  Process * p;
+  gint64 arrival, cycles, period, used;
+  int i, lines, end;
+
+  if(sim->num_cpus != 1 || sim->num_nodes != 1 || sim->sort == GANG_SORT || sim->metrics != NULL || sim->locks != NULL
+    || DISPATCH_COST != 0 || CONTEXT_SWITCH_COST != 0 || CACHE_WARMUP_COST != 0) return INVALID_MOVE;
+  if(g_queue_get_length(sim->running) != 1 || !g_queue_is_empty(sim->ready) || !g_queue_is_empty(sim->waiting)) return INVALID_MOVE;
+  p = (Process *) link->data;
+  if(p->last_start != current_time) return INVALID_MOVE; //cycles start when the process is put on the cpu
+  if(p->tmpl->program != NULL) return INVALID_MOVE; //its bursts change from one cycle to the next
+
+  //ties go the way get_next_move() breaks them: time slice before I/O before completion
+  if(p->tmpl->iofreq < p->tmpl->rr && p->tmpl->iofreq <= p->remaining && p->tmpl->iodur != INT_MAX) {
+    used = p->tmpl->iofreq;
+    period = (gint64) p->tmpl->iofreq + p->tmpl->iodur;
+    cycle[0] = (TraceEvent) { p->tmpl->iofreq, p->pid, RUNNING_STATE, WAITING_STATE };
+    cycle[1] = (TraceEvent) { period, p->pid, WAITING_STATE, READY_STATE };
+    cycle[2] = (TraceEvent) { period, p->pid, READY_STATE, RUNNING_STATE };
+    lines = 3;
+  }
+  else if(p->tmpl->rr != INT_MAX && p->tmpl->rr <= p->tmpl->iofreq && p->tmpl->rr <= p->remaining) {
+    used = period = p->tmpl->rr;
+    cycle[0] = (TraceEvent) { p->tmpl->rr, p->pid, RUNNING_STATE, READY_STATE };
+    cycle[1] = (TraceEvent) { p->tmpl->rr, p->pid, READY_STATE, RUNNING_STATE };
+    lines = 2;
+  }
+  else return INVALID_MOVE;
+
+  //every move of the cycles comes before the next arrival
+  arrival = g_queue_is_empty(sim->all) ? INT_MAX : get_head_start_val(sim->all);
+  cycles = MIN(p->remaining / used, (arrival - 1 - current_time) / period);
+  if(cycles < FAST_FORWARD_MIN_CYCLES) return INVALID_MOVE;
+
+  for(i = 0; i < lines; i++) cycle[i].time += current_time;
+  record_cycles(sim, cycle, lines, cycles, period);
+
+  //the state the moves of the cycles would have left behind
+  end = current_time + cycles * period;
+  p->remaining -= cycles * used;
+  p->last_stop = end - (period - used);
+  if(lines == 3) p->last_io_start = p->last_stop;
+  p->last_cpu = p->cpu;
+  p->ready_since = end;
+  p->last_start = end;
+  sim->stats.dispatches += cycles;
+  sim->stats.idle_time += cycles * (period - used); //the cpu idles while the process waits for its I/O
+  sim->stats.end_time = end;
+  if(ready_heap_used(sim)) sim->ready_seq += cycles;
+  sim->timer_seq += cycles * (lines - 1) - 1;
+  update_timers(sim, p, RUNNING_TO_READY, link); //cancels the timers of the first cycle
+  update_timers(sim, p, READY_TO_RUNNING, link);
+  return end;
+}
+
+/**
+ * Removes the entry at a position of the heap ordering the ready queue
+ * @param sim the simulation
+ * @param i   the position
+ */
+void ready_heap_remove_at(Simulation * sim, guint i) {
+  GArray * heap = sim->ready_heap;
+  struct ready_entry e;
+  guint j;
+
+  for(; i > 0; i = j) { //float the entry up to the root, then pop it
+    e = g_array_index(heap, struct ready_entry, i);
+    j = (i - 1) / 2;
+    ready_heap_set(heap, i, &g_array_index(heap, struct ready_entry, j));
+    ready_heap_set(heap, j, &e);
+  }
+  ready_heap_pop(sim);
+}
+
+/**
+ * Removes a ready process from the heap ordering the ready queue, searching the heap for it
+ * @param sim  the simulation
+ * @param link element of the process in the ready queue
+ */
+void ready_heap_remove(Simulation * sim, GList * link) {
+  GArray * heap = sim->ready_heap;
+  guint i;
+
+  for(i = 0; i < heap->len && g_array_index(heap, struct ready_entry, i).link != link; i++);
+  assert(i < heap->len);
+  ready_heap_remove_at(sim, i);
+}
+
+/**
+ * Gets the time the next running process reaches the next point of its lock script
+ * @param  sim  the simulation, with locks
+ * @param  link set to the element of that process in the running queue
+ * @return      the time, INT_MAX if no running process has a point left
+ */
+int next_lock_point(Simulation * sim, GList ** link) {
+  struct lock_state * s;
+  GList * l;
+  gint64 t;
+  int next = INT_MAX;
+
+  for(l = sim->running->head; l != NULL; l = l->next) {
+    Process * p = (Process *) l->data;
+    if((s = lock_state(sim, p)) == NULL || s->cursor == s->count) continue;
+    //the process has run total - remaining before it was put on the cpu at last_start
+    t = (gint64) p->last_start + s->points[s->cursor].at - (p->tmpl->total - p->remaining);
+    if(t < next) {
+      next = t;
+      *link = l;
+    }
+  }
+  return next;
+}
+
+/**
+ * Gives a unit of a lock to a process that reached the point acquiring it
+ * @param sim the simulation
+ * @param s   where the process is in its lock script
+ * @param l   the lock
+ * @param p   the process
+ */
+void lock_take(Simulation * sim, struct lock_state * s, struct lock * l, Process * p) {
+  l->units--;
+  if(l->mutex) l->owner = p;
+  s->cursor++;
+  s->held++;
+  s->blocked = FALSE;
+  sim->locks->acquisitions++;
+}
+
+/**
+ * Orders waiter keys
+ */
+gint compare_waiter_keys(gconstpointer a, gconstpointer b) {
+  int x = ((const struct waiter_key *) a)->key, y = ((const struct waiter_key *) b)->key;
+
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Adds the sort key of a process blocked on a mutex to the keys of its waiters, making the keys
+ * the process had on it before stale
+ * @param l   the mutex
+ * @param s   where the process is in its lock script
+ * @param key sort key of the process
+ */
+void waiter_key_push(struct lock * l, struct lock_state * s, int key) {
+  GArray * keys = l->keys;
+  struct waiter_key e = { key, ++s->wait, s };
+  guint i, n, parent;
+
+  if(keys->len > 2 * g_queue_get_length(l->waiters) + 16) { //mostly stale: keep the others, sorted is a heap too
+    for(i = 0, n = 0; i < keys->len; i++) {
+      struct waiter_key * k = &g_array_index(keys, struct waiter_key, i);
+      if(k->state->blocked && k->state->wait == k->wait) g_array_index(keys, struct waiter_key, n++) = *k;
+    }
+    g_array_set_size(keys, n);
+    g_array_sort(keys, compare_waiter_keys);
+  }
+  i = keys->len;
+  g_array_set_size(keys, keys->len + 1);
+  for(; i > 0; i = parent) { //sift up
+    parent = (i - 1) / 2;
+    if(g_array_index(keys, struct waiter_key, parent).key <= key) break;
+    g_array_index(keys, struct waiter_key, i) = g_array_index(keys, struct waiter_key, parent);
+  }
+  g_array_index(keys, struct waiter_key, i) = e;
+}
+
+/**
+ * Gets the best sort key of the processes blocked on a mutex, dropping the stale keys on top
+ * @param  l the mutex
+ * @return   the key, NO_BOOST if no process is blocked on it
+ */
+int waiter_key_best(struct lock * l) {
+  GArray * keys = l->keys;
+  struct waiter_key * top, e;
+  guint i, child, n;
+
+  while(keys->len > 0) {
+    top = &g_array_index(keys, struct waiter_key, 0);
+    if(top->state->blocked && top->state->wait == top->wait) return top->key;
+    n = keys->len - 1;
+    e = g_array_index(keys, struct waiter_key, n);
+    for(i = 0; (child = 2 * i + 1) < n; i = child) { //sift the last key down from the root
+      if(child + 1 < n && g_array_index(keys, struct waiter_key, child + 1).key < g_array_index(keys, struct waiter_key, child).key) child++;
+      if(g_array_index(keys, struct waiter_key, child).key >= e.key) break;
+      g_array_index(keys, struct waiter_key, i) = g_array_index(keys, struct waiter_key, child);
+    }
+    if(n > 0) g_array_index(keys, struct waiter_key, i) = e;
+    g_array_set_size(keys, n);
+  }
+  return NO_BOOST;
+}
+
+/**
+ * Makes a process inherit the sort key of a process blocking on its mutex, and the owner of the
+ * mutex it is blocked on in turn (priority inheritance). A ready owner moves up the ready queue
+ * right away, found through its position in the ready heap (the reference engine searches and
+ * sorts its ready queue).
+ * @param sim the simulation
+ * @param p   the owner of the mutex
+ * @param key sort key of the process that blocked
+ */
+void lock_inherit(Simulation * sim, Process * p, int key) {
+  struct lock_state * s;
+  struct lock * l;
+  GList * link;
+
+  if(sim->sort != SJF_SORT && sim->sort != SRTF_SORT) return;
+  while(p != NULL && (s = lock_state(sim, p)) != NULL && key < ready_key(sim, p)) {
+    s->boost = key;
+    if(ready_heap_used(sim)) {
+      if(s->position != NO_POSITION) { //it goes after the processes with the same key, like with a stable sort
+        link = g_array_index(sim->ready_heap, struct ready_entry, s->position).link;
+        ready_heap_remove_at(sim, s->position);
+        ready_heap_push(sim, link, key);
+      }
+    }
+    else if(p->cpu == NO_CPU && g_queue_find(sim->ready, p) != NULL) g_queue_sort(sim->ready, sort_ready_key, sim);
+    if(!s->blocked) break;
+    l = &sim->locks->locks[s->points[s->cursor].lock];
+    waiter_key_push(l, s, key);
+    p = l->owner;
+  }
+}
+
+/**
+ * Releases a lock held by a process, handing it to the first process blocked on it, which
+ * becomes ready
+ * @param sim          the simulation
+ * @param p            the process
+ * @param l            the lock
+ * @param current_time the current time
+ */
+void lock_release(Simulation * sim, Process * p, struct lock * l, int current_time) {
+  struct lock_state * s = lock_state(sim, p), * ws;
+  Process * w;
+
+  if(--s->held == 0) s->boost = NO_BOOST;
+  l->units++;
+  if(l->owner == p) l->owner = NULL;
+  if(g_queue_is_empty(l->waiters)) return;
+  w = g_queue_peek_head(l->waiters);
+  ws = lock_state(sim, w);
+  lock_take(sim, ws, l, w);
+  sim->locks->blocked_time += current_time - ws->blocked_since;
+  execute_move(sim, l->waiters, sim->ready, BLOCKED_TO_READY, current_time);
+  if(PRIORITY_INHERITANCE && l->mutex) { //the new owner inherits from the rest
+    if(g_queue_is_empty(l->waiters)) g_array_set_size(l->keys, 0); //only stale keys are left
+    else lock_inherit(sim, w, waiter_key_best(l));
+  }
+}
+
+/**
+ * Makes the running process at the next point of its lock script acquire or release the lock of
+ * the point. Acquiring a lock with no units left blocks it; otherwise it keeps running.
+ * @param sim          the simulation, with locks
+ * @param link         element of the process in the running queue
+ * @param current_time the current time
+ */
+void lock_step(Simulation * sim, GList * link, int current_time) {
+  Process * p = (Process *) link->data;
+  struct lock_state * s = lock_state(sim, p);
+  const struct lock_point * point = &s->points[s->cursor];
+  struct lock * l = &sim->locks->locks[point->lock];
+
+  if(point->acquire != s->cursor) {
+    s->cursor++;
+    lock_release(sim, p, l, current_time);
+  }
+  else if(l->units > 0) lock_take(sim, s, l, p);
+  else {
+    sim->locks->contended++;
+    s->blocked = TRUE;
+    s->blocked_since = current_time;
+    move_to_head(sim->running, link);
+    execute_move(sim, sim->running, l->waiters, RUNNING_TO_BLOCKED, current_time);
+    sim->locks->longest_queue = MAX(sim->locks->longest_queue, g_queue_get_length(l->waiters));
+    if(PRIORITY_INHERITANCE && l->mutex) {
+      waiter_key_push(l, s, ready_key(sim, p));
+      lock_inherit(sim, l->owner, ready_key(sim, p));
+    }
+  }
+}
+
+/**
+ * Releases the locks a process still holds when it leaves the simulation, in script order
+ * @param sim          the simulation, with locks
+ * @param p            the process, terminated or rejected
+ * @param current_time the current time
+ */
+void lock_release_all(Simulation * sim, Process * p, int current_time) {
+  struct lock_state * s = lock_state(sim, p);
+  guint i, reached;
+
+  if(s == NULL) return;
+  reached = s->cursor;
+  s->cursor = s->count;
+  for(i = reached; i < s->count; i++) {
+    if(s->points[i].acquire != i && s->points[i].acquire < reached) lock_release(sim, p, &sim->locks->locks[s->points[i].lock], current_time);
+  }
+}
+
+/**
+ * Frees the locks of a simulation, with the processes still blocked on them
+ * @param k the locks
+ */
+void locks_free(struct locks * k) {
+  guint i;
+
+  for(i = 0; i < k->count; i++) {
+    g_queue_free_full(k->locks[i].waiters, free);
+    g_array_free(k->locks[i].keys, TRUE);
+  }
+  g_hash_table_destroy(k->scripts);
+  free(k->locks);
+  free(k->points);
+  free(k->states);
+  free(k);
+}
+
+/**
+ * Turns a process away: moves it to the rejected processes and records it
+ * @param sim          the simulation
+ * @param from         queue holding the process (all or ready)
+ * @param link         element of the process in that queue
+ * @param state        state of the process (NEW_STATE or READY_STATE)
+ * @param current_time the current time
+ */
+void reject_process(Simulation * sim, GQueue * from, GList * link, int state, int current_time) {
+  Process * p = link->data;
+
+  if(state == READY_STATE && ready_heap_used(sim)) ready_heap_remove(sim, link);
+  g_queue_unlink(from, link);
+  g_queue_push_tail_link(sim->rejected, link);
+  if(p->gang != NULL) { //the rest of the gang goes on without it
+    p->gang->live--;
+    if(state == READY_STATE) p->gang->ready--;
+  }
+  if(state == NEW_STATE) sim->stats.work += p->tmpl->total; //it arrived all the same
+  sim->stats.rejected++;
+  sim->stats.rejected_work += p->remaining;
+  sim->stats.end_time = current_time;
+  record_move(sim, current_time, p->pid, state, REJECTED_STATE);
+  if(sim->locks != NULL) lock_release_all(sim, p, current_time);
+  if(sim->source != NULL || sim->periodic != NULL) process_recycle(sim, sim->rejected, link);
+}
+
+/**
+ * Decides whether the next arrival enters the ready queue. The token bucket fills up at
+ * TOKEN_RATE arrivals per 1000 time units, up to TOKEN_BURST, and every admitted arrival takes
+ * one; without a token the arrival is rejected. A ready queue of READY_LIMIT processes is full:
+ * the arrival is rejected, or with ADMIT_DROP_OLDEST the process that has been ready the longest
+ * is dropped to make room for it. Finding it scans the ready queue, which READY_LIMIT keeps short.
+ * @param  sim          the simulation
+ * @param  current_time time of the arrival
+ * @return              TRUE if the arrival is admitted
+ */
+gboolean admit(Simulation * sim, int current_time) {
+  GList * link, * oldest = NULL;
+
+  if(TOKEN_RATE > 0) {
+    sim->tokens = MIN(sim->tokens + (gint64) (current_time - sim->tokens_time) * TOKEN_RATE, (gint64) TOKEN_BURST * 1000);
+    sim->tokens_time = current_time;
+    if(sim->tokens < 1000) return FALSE;
+  }
+  if(READY_LIMIT > 0 && g_queue_get_length(sim->ready) >= READY_LIMIT) {
+    if(ADMISSION != ADMIT_DROP_OLDEST) return FALSE;
+    //ties go to the lowest sort key, then the first in the queue: the engines order their ready
+    //queues differently, but processes with the same key in the order they became ready
+    for(link = sim->ready->head; link != NULL; link = link->next) {
+      Process * p = link->data, * o = oldest != NULL ? oldest->data : NULL;
+      if(o == NULL || p->ready_since < o->ready_since
+          || (p->ready_since == o->ready_since && ready_key(sim, p) < ready_key(sim, o))) oldest = link;
+    }
+    reject_process(sim, sim->ready, oldest, READY_STATE, current_time);
+  }
+  if(TOKEN_RATE > 0) sim->tokens -= 1000;
+  return TRUE;
+}
+
+/**
+ * Gets the job of a process in the dependencies of its simulation
+ * @param  d   the dependencies
+ * @param  pid process id of the process
+ * @return     job number + 1, 0 if the process has no dependencies
+ */
+guint dependency_job(struct dependencies * d, int pid) {
+  return GPOINTER_TO_UINT(g_hash_table_lookup(d->jobs, GINT_TO_POINTER(pid)));
+}
+
+/**
+ * Holds back the arrival at the head of the all queue while parent jobs of its job have not
+ * finished
+ * @param  sim the simulation, with dependencies
+ * @return     TRUE if the arrival was held back
+ */
+gboolean hold_process(Simulation * sim) {
+  struct dependencies * d = sim->dependencies;
+  GList * link = sim->all->head;
+  guint j = dependency_job(d, ((Process *) link->data)->pid);
+
+  if(j-- == 0 || d->pending[j] == 0) return FALSE;
+  g_queue_unlink(sim->all, link);
+  link->next = d->held[j];
+  if(link->next != NULL) link->next->prev = link;
+  d->held[j] = link;
+  d->held_count++;
+  return TRUE;
+}
+
+/**
+ * Counts a terminated process towards its job and, once the whole job finished, releases the
+ * successors it was the last parent of: their held processes arrive, in order of arrival, at
+ * the current time. Costs the out-degree of the job plus the processes released.
+ * @param sim          the simulation, with dependencies
+ * @param p            the process that terminated
+ * @param current_time the current time
+ */
+void release_successors(Simulation * sim, Process * p, int current_time) {
+  struct dependencies * d = sim->dependencies;
+  guint j = dependency_job(d, p->pid), i, s;
+  GList * link, * prev;
+
+  if(j-- == 0 || --d->live[j] > 0) return;
+  for(i = d->first[j]; i < d->first[j + 1]; i++) {
+    s = d->successors[i];
+    if(--d->pending[s] > 0) continue;
+    for(link = g_list_last(d->held[s]); link != NULL; link = prev) {
+      prev = link->prev;
+      link->next = link->prev = NULL;
+      g_queue_push_head_link(sim->all, link);
+      d->held_count--;
+      if((READY_LIMIT > 0 || TOKEN_RATE > 0) && !admit(sim, current_time)) reject_process(sim, sim->all, link, NEW_STATE, current_time);
+      else execute_move(sim, sim->all, sim->ready, NEW_TO_READY, current_time);
+    }
+    d->held[s] = NULL;
+  }
+}
+
+/**
+ * Frees the dependencies of a simulation, with the processes still held back
+ * @param d the dependencies
+ */
+void dependencies_free(struct dependencies * d) {
+  GList * link, * next;
+  guint j;
+
+  for(j = 0; j < d->count; j++) {
+    for(link = d->held[j]; link != NULL; link = next) {
+      next = link->next;
+      free(link->data);
+      g_list_free_1(link);
+    }
+  }
+  g_hash_table_destroy(d->jobs);
+  free(d->first);
+  free(d->successors);
+  free(d->pending);
+  free(d->live);
+  free(d->held);
+  free(d);
+}
+
+/**
+ * Queues the job of a periodic task released next in the all queue, in a free slot if there is
+ * one. It goes after the processes released before it, and after the jobs released at the same
+ * time by the tasks declared before its own, so that the queue is in the same order whenever
+ * the tasks are in the same phases.
+ * @param sim  the simulation, with periodic tasks
+ * @param task the task, with the release time of its job in next
+ */
+void periodic_queue(Simulation * sim, struct periodic_task * task) {
+  struct periodic_task * o;
+  GList * link, * prev;
+  Process * q;
+
+  if((link = sim->free_slots) != NULL) sim->free_slots = link->next;
+  else {
+    link = g_list_alloc();
+    link->data = NULL;
+  }
+  link->data = process_instantiate(link->data, task->pid, task->next, task->tmpl);
+  for(prev = sim->all->tail; prev != NULL; prev = prev->prev) { //releases come in order, so from the tail
+    q = prev->data;
+    if(q->start < task->next || (q->start == task->next && ((o = periodic_task(sim->periodic, q)) == NULL || o < task))) break;
+  }
+  link->prev = prev;
+  link->next = prev != NULL ? prev->next : sim->all->head;
+  if(link->next != NULL) link->next->prev = link;
+  else sim->all->tail = link;
+  if(prev != NULL) prev->next = link;
+  else sim->all->head = link;
+  sim->all->length++;
+}
+
+/**
+ * Releases a job of a periodic task: queues the job of the next period, unless it falls at or
+ * after the horizon
+ * @param sim the simulation, with periodic tasks
+ * @param p   the arrival at the head of the all queue
+ */
+void periodic_release(Simulation * sim, Process * p) {
+  struct periodic * r = sim->periodic;
+  struct periodic_task * task = periodic_task(r, p);
+
+  if(task == NULL || task->next != p->start) return;
+  r->released++;
+  if((gint64) task->next + task->period < r->horizon) {
+    task->next += task->period;
+    periodic_queue(sim, task);
+  }
+  else {
+    task->next = INT_MAX;
+    r->pending--;
+  }
+}
+
+/**
+ * Looks for the schedule of the periodic tasks repeating a hyperperiod, after a move. The first
+ * instant of each hyperperiod window where every cpu is idle, nothing waits for I/O, every task
+ * has its next job queued and only jobs just released are ready is compared with the one of the
+ * window before. The moves from such an instant on depend only on the phases of the tasks and on
+ * the ready jobs, so if those are the same one hyperperiod later, every hyperperiod after it
+ * repeats the transitions collected in between, until releases stop at the horizon. Those
+ * hyperperiods are written to the trace from the collected transitions in one step (see
+ * record_cycles()), their stats extrapolated, and the jobs queued moved ahead to the state the
+ * last of them leaves behind. Only with ENGINE_HEAP, one node, no dispatch costs, no admission
+ * control and no gang scheduling, locks, dependencies or streaming metrics.
+ * @param  sim          the simulation, with periodic tasks
+ * @param  current_time time of the move
+ * @return              time of the last move made
+ */
+int periodic_shortcut(Simulation * sim, int current_time) {
+  struct periodic * r = sim->periodic;
+  struct overhead_stats * s = &sim->stats, * m = &r->stats;
+  TraceEvent * cycle;
+  GList * link;
+  Process * p;
+  gint64 window, n;
+  int shift, last = 0;
+  guint i, j;
+
+  if(!PERIODIC_SHORTCUT || r->hyperperiod == 0 || r->skipped > 0 || sim->engine != ENGINE_HEAP || sim->num_nodes != 1
+    || sim->sort == GANG_SORT || sim->metrics != NULL || sim->locks != NULL || sim->dependencies != NULL
+    || DISPATCH_COST != 0 || CONTEXT_SWITCH_COST != 0 || CACHE_WARMUP_COST != 0 || READY_LIMIT > 0 || TOKEN_RATE > 0) return current_time;
+  window = current_time / r->hyperperiod;
+  if(window == r->window) return current_time; //marked an instant of this window already
+  if(r->window >= 0 && window > r->window + 1) { //the window after the mark had no instant to compare
+    r->window = -1;
+    g_array_set_size(r->events, 0);
+  }
+  if(!g_queue_is_empty(sim->running) || !g_queue_is_empty(sim->waiting)) return current_time;
+  if(r->pending != r->count || g_queue_get_length(sim->all) != r->pending || get_head_start_val(sim->all) <= current_time) return current_time;
+  for(link = sim->ready->head; link != NULL; link = link->next) {
+    p = link->data;
+    if(periodic_task(r, p) == NULL || p->start != current_time || p->remaining != p->tmpl->total || p->last_cpu != NO_CPU) return current_time;
+  }
+
+  //same phases and the same jobs ready as at the mark, one hyperperiod ago
+  if(r->window >= 0 && window == r->window + 1 && current_time - r->mark == r->hyperperiod && r->ready->len == g_queue_get_length(sim->ready)) {
+    for(i = 0; i < r->count && r->tasks[i].next - current_time == r->phases[i]; i++) last = MAX(last, r->tasks[i].next);
+    for(link = sim->ready->head, j = 0; link != NULL && ((Process *) link->data)->pid == g_array_index(r->ready, int, j); link = link->next) j++;
+    n = (r->horizon - 1 - (gint64) last) / r->hyperperiod; //every task keeps releasing until then
+    if(i == r->count && j == r->ready->len && n > 0) {
+      r->window = -1; //done collecting
+      cycle = (TraceEvent *) r->events->data;
+      for(i = 0; i < r->events->len; i++) cycle[i].time += r->hyperperiod;
+      record_cycles(sim, cycle, r->events->len, n, r->hyperperiod);
+
+      //the state the hyperperiods would have left behind
+      shift = n * r->hyperperiod;
+      for(link = sim->ready->head; link != NULL; link = link->next) {
+        p = link->data;
+        p->start += shift;
+        p->ready_since += shift;
+      }
+      for(link = sim->all->head; link != NULL; link = link->next) {
+        p = link->data;
+        p->start += shift;
+        p->ready_since += shift;
+      }
+      for(i = 0; i < r->count; i++) r->tasks[i].next += shift;
+      if(ready_heap_used(sim)) { //a shift of every key keeps the heap in order
+        for(i = 0; i < sim->ready_heap->len; i++) {
+          struct ready_entry * e = &g_array_index(sim->ready_heap, struct ready_entry, i);
+          e->key = ready_key(sim, e->link->data);
+        }
+      }
+      s->dispatches += n * (s->dispatches - m->dispatches);
+      s->context_switches += n * (s->context_switches - m->context_switches);
+      s->migrations += n * (s->migrations - m->migrations);
+      s->cross_node_migrations += n * (s->cross_node_migrations - m->cross_node_migrations);
+      s->migration_time += n * (s->migration_time - m->migration_time);
+      s->work += n * (s->work - m->work);
+      s->idle_time += n * (s->idle_time - m->idle_time);
+      s->waste_time += n * (s->waste_time - m->waste_time);
+      s->end_time = current_time + shift;
+      r->released += n * (r->released - r->counts[0]);
+      r->finished += n * (r->finished - r->counts[1]);
+      r->misses += n * (r->misses - r->counts[2]);
+      r->skipped = n;
+      r->skipped_from = current_time;
+      g_array_set_size(r->events, 0);
+      return current_time + shift;
+    }
+  }
+
+  //mark the instant, and collect the transitions from it on
+  r->window = window;
+  r->mark = current_time;
+  for(i = 0; i < r->count; i++) r->phases[i] = r->tasks[i].next - current_time;
+  g_array_set_size(r->ready, 0);
+  for(link = sim->ready->head; link != NULL; link = link->next) g_array_append_val(r->ready, ((Process *) link->data)->pid);
+  g_array_set_size(r->events, 0);
+  r->stats = sim->stats;
+  r->counts[0] = r->released;
+  r->counts[1] = r->finished;
+  r->counts[2] = r->misses;
+  return current_time;
+}
+
+/**
+ * Frees the periodic tasks of a simulation, with the free slots of its jobs
+ * @param sim the simulation
+ */
+void periodic_free(Simulation * sim) {
+  struct periodic * r = sim->periodic;
+  GList * link;
+
+  while((link = sim->free_slots) != NULL) {
+    sim->free_slots = link->next;
+    free(link->data);
+    g_list_free_1(link);
+  }
+  g_hash_table_destroy(r->by_pid);
+  free(r->tasks);
+  free(r->phases);
+  g_array_free(r->ready, TRUE);
+  g_array_free(r->events, TRUE);
+  free(r);
+  sim->periodic = NULL;
+}
+
+/**
+ * Determines which transitions to make and calls the execute_move() method
+ * @param  sim
+ * @param  current_time
+ * @return the time of the move made, INVALID_MOVE when the simulation is done
+ */
+int get_next_move(Simulation * sim, int current_time) {
+  assert(current_time >= 0);
+  int move = INVALID_MOVE;
+  int all_to_ready = INT_MAX, ready_to_running = INT_MAX,running_to_terminated = INT_MAX,
+    running_to_waiting = INT_MAX, waiting_to_ready = INT_MAX, running_to_ready = INT_MAX,
+    lock_point = INT_MAX;
+
+  GQueue * all = sim->all;
+  GQueue * ready = sim->ready;
+  GQueue * running = sim->running;
+  GQueue * waiting = sim->waiting;
+  GQueue * terminated = sim->terminated;
+  GQueue * from;
+  GQueue * to;
+  GList * link;
+  GList * rr_link = NULL, * io_link = NULL, * term_link = NULL; //running processes owning the soonest events
+  GList * io_done_link = NULL; //waiting process whose I/O completes first
+  GList * dispatch_link = NULL; //ready process to dispatch next
+  GList * preempt_link = NULL; //running process with the largest sort key, for SRTF_PREEMPT, RM and EDF
+  GList * lock_link = NULL; //running process reaching the next point of its lock script first
+  int preempt_left = 0;
+  int end;
+
+  if(sim->source != NULL && g_queue_is_empty(all)) source_refill(sim);
+  if(FAST_FORWARD != FAST_FORWARD_OFF && sim->engine == ENGINE_HEAP && (end = fast_forward(sim, current_time)) != INVALID_MOVE) {
+    return end;
+  }
+
+  /*-----
+   The next move is determined based on the SOONEST of any of these times:
+            - ArrivalTime of processes in the new state OR
+            - I/O time of currently running process OR
+            - End time of a process' I/O operation OR
+            - Remaining time left for the process to complete execution
+            - Next I/O time for the currently running process
+   --------*/
+  if(!g_queue_is_empty(all)) all_to_ready = get_head_start_val(all);
+  if(!g_queue_is_empty(ready) && g_queue_get_length(running) < sim->num_cpus) dispatch_link = pick_ready(sim);
+  if(dispatch_link != NULL) ready_to_running = MAX(current_time, ((Process *) dispatch_link->data)->start);
+
+  if(sim->locks != NULL && (lock_point = next_lock_point(sim, &lock_link)) < current_time) lock_point = current_time; //scans the running processes
+
+  if(sim->engine == ENGINE_HEAP) { //the soonest events are at the top of the timer heaps
+    waiting_to_ready = timer_next(sim, TIMER_IO_DONE, &io_done_link);
+    running_to_waiting = timer_next(sim, TIMER_IO, &io_link);
+    running_to_terminated = timer_next(sim, TIMER_TERMINATE, &term_link);
+    running_to_ready = timer_next(sim, TIMER_SLICE, &rr_link);
+  }
+  else {
+    // I/O durations differ between processes, so the first to finish is not always the first to start
+    for(link = waiting->head; link != NULL; link = link->next) {
+      Process * p = (Process *) link->data;
+      int io_done_time = p->last_io_start + burst_io(p);
+
+      if((io_done_time < 0 ? INT_MAX : io_done_time) < waiting_to_ready) {
+        waiting_to_ready = io_done_time;
+        io_done_link = link;
+      }
+    }
+
+    // every running process has its own I/O, completion and time slice events, keep the soonest of each
+    for(link = running->head; link != NULL; link = link->next) {
+      Process * p = (Process *) link->data;
+      int io_time = p->last_start + burst_cpu(p);
+      int term_time = p->remaining + p->last_start;
+      int rr_time = p->last_start + p->tmpl->rr;
+
+      if((io_time < 0 ? INT_MAX : io_time) < running_to_waiting) {
+        running_to_waiting = io_time;
+        io_link = link;
+      }
+      if((term_time < 0 ? INT_MAX : term_time) < running_to_terminated) {
+        running_to_terminated = term_time;
+        term_link = link;
+      }
+      if((rr_time < 0 ? INT_MAX : rr_time) < running_to_ready) {
+        running_to_ready = rr_time;
+        rr_link = link;
+      }
+    }
+  }
+
+  //a process only gets preempted once it ran, or migration penalties could bounce it between cpus forever,
+  //and never as it completes: it has no work left to give up the cpu with
+  if((SRTF_PREEMPT && sim->sort == SRTF_SORT) || sim->sort == RM_SORT || sim->sort == EDF_SORT) {
+    for(link = running->head; link != NULL; link = link->next) {
+      Process * p = (Process *) link->data;
+      int left = sim->sort == SRTF_SORT ? MIN(p->remaining - (current_time - p->last_start), lock_boost(sim, p)) : ready_key(sim, p);
+      if(p->last_start < current_time && (gint64) p->last_start + p->remaining > current_time
+          && (preempt_link == NULL || left > preempt_left)) {
+        preempt_left = left;
+        preempt_link = link;
+      }
+    }
+  }
+
+  // a ready process with less remaining time (a shorter period, an earlier deadline) than a running one takes its cpu right away
+  if(preempt_link != NULL && g_queue_get_length(running) >= sim->num_cpus && !g_queue_is_empty(ready)
+      && ready_key(sim, (Process *) ready_head(sim)->data) < preempt_left) {
+    running_to_ready = current_time;
+    rr_link = preempt_link;
+  }
+
+  //sanitize any addition overflows
+  all_to_ready = all_to_ready < 0 ? INT_MAX : all_to_ready;
+  ready_to_running = ready_to_running < 0 ? INT_MAX : ready_to_running;
+  running_to_waiting = running_to_waiting < 0 ? INT_MAX : running_to_waiting;
+  running_to_terminated = running_to_terminated < 0 ? INT_MAX : running_to_terminated;
+  waiting_to_ready = waiting_to_ready < 0 ? INT_MAX : waiting_to_ready;
+  running_to_ready = running_to_ready < 0 ? INT_MAX : running_to_ready;
+
+  int min = MIN(MIN(MIN(MIN(MIN(all_to_ready, ready_to_running), running_to_terminated), running_to_waiting), waiting_to_ready), running_to_ready);
+
+  //a process acquires or releases a lock before anything else happens to it at that cpu time
+  if(lock_point <= min && lock_point != INT_MAX) {
+    account_idle_cpus(sim, current_time, lock_point);
+    lock_step(sim, lock_link, lock_point);
+    return lock_point;
+  }
+  if(min == INT_MAX) return move;
+  else if(min == waiting_to_ready) {
+    move = WAITING_TO_READY;
+    from = waiting;
+    to = ready;
+    move_to_head(waiting, io_done_link);
+  }
+  else if(min == all_to_ready) {
+    if(sim->periodic != NULL) periodic_release(sim, all->head->data); //queues the next job of its task
+    if(sim->dependencies != NULL && hold_process(sim)) { //stays new until its parent jobs finish
+      account_idle_cpus(sim, current_time, min);
+      return min;
+    }
+    if((READY_LIMIT > 0 || TOKEN_RATE > 0) && !admit(sim, min)) {
+      account_idle_cpus(sim, current_time, min);
+      reject_process(sim, all, all->head, NEW_STATE, min);
+      return min;
+    }
+    move = NEW_TO_READY;
+    from = all;
+    to = ready;
+  }
+
+  else if(min == running_to_ready) {
+    move = RUNNING_TO_READY;
+    from = running;
+    to = ready;
+    move_to_head(running, rr_link);
+  }
+  else if(min == running_to_waiting) {
+    move = RUNNING_TO_WAITING;
+    from = running;
+    to = waiting;
+    move_to_head(running, io_link);
+  }
+  else if(min == running_to_terminated) {
+    move = RUNNING_TO_TERMINATED;
+    from = running;
+    to = terminated;
+    move_to_head(running, term_link);
+  }
+  else if(min == ready_to_running) {
+    move = READY_TO_RUNNING;
+    from = ready;
+    to = running;
+    move_to_head(ready, dispatch_link);
+  }
+  else return move;
+  /*--------------------------------------------------*/
+  //ready to running is being checked before waiting to ready and that is wrong!
+
+  account_idle_cpus(sim, current_time, min);
+  current_time = min;
+  execute_move(sim, from, to, move, current_time); //execute the move
+  if(move == RUNNING_TO_TERMINATED && sim->locks != NULL) lock_release_all(sim, g_queue_peek_tail(to), current_time);
+  if(move == RUNNING_TO_TERMINATED && sim->dependencies != NULL) release_successors(sim, g_queue_peek_tail(to), current_time);
+  if(sim->periodic != NULL) return periodic_shortcut(sim, current_time);
+  return current_time;
+}
+
+/**
+ * Reallocate all the processes from these queues to the system
+ *
+ * @param all        the all/new queue
+ * @param ready      the ready queue
+ * @param running    the running queue
+ * @param waiting    the waiting
+ * @param terminated the terminated queue
+ */
+void realloc_q_procs(GQueue * all, GQueue * ready, GQueue * running, GQueue * waiting, GQueue * terminated) {
+  while(!g_queue_is_empty(all)) {
+    free(g_queue_pop_head(all));
+  }
+  while(!g_queue_is_empty(ready)) {
+    free(g_queue_pop_head(ready));
+  }
+  while(!g_queue_is_empty(running)) {
+    free(g_queue_pop_head(running));
+  }
+  while(!g_queue_is_empty(waiting)) {
+    free(g_queue_pop_head(waiting));
+  }
+  while(!g_queue_is_empty(terminated)) {
+    free(g_queue_pop_head(terminated));
+  }
+}
+
+/**
+ * Reallocate all the q to the system by freeing all processes in the queues
+ * and then by freeing the queues themselves
+ */
+void realloc_q(GQueue * all, GQueue * ready, GQueue * running, GQueue * waiting, GQueue * terminated) {
+  realloc_q_procs(all, ready, running, waiting, terminated);
+  g_queue_free(all);
+  g_queue_free(ready);
+  g_queue_free(running);
+  g_queue_free(waiting);
+  g_queue_free(terminated);
+}
 
 /**
- * Using a double ended Queue
- * From http://developer.gnome.org/glib/2.34/glib-Double-ended-Queues.html
-*/
+ * Creates a simulation of a workload on a machine
+ * @param  topo     the machine
+ * @param  all      queue holding all the processes of the workload, owned by the simulation from now on
+ * @param  sort     the scheduling algorithm
+ * @param  filename file the trace is appended to (NULL for no trace)
+ * @return          the simulation
+ */
+Simulation * simulation_new(Topology * topo, GQueue * all, int sort, const char * filename) {
+  Simulation * sim = calloc(1, sizeof(Simulation));
+  int i;
+
+  assert(sim != NULL);
+  sim->all = all;
+  sim->ready = g_queue_new();
+  sim->running = g_queue_new();
+  sim->waiting = g_queue_new();
+  sim->terminated = g_queue_new();
+  sim->rejected = g_queue_new();
+  sim->sort = sort;
+  sim->engine = ENGINE;
+  sim->ready_heap = g_array_new(FALSE, FALSE, sizeof(struct ready_entry));
+  for(i = 0; i < NUM_TIMERS; i++) sim->timers[i] = g_array_new(FALSE, FALSE, sizeof(struct timer));
+  sim->tokens = (gint64) TOKEN_BURST * 1000; //the token bucket starts full
+  g_queue_sort(all, fcfs_algorithm, NULL); //sort in earliest first always
+
+  if(filename != NULL) {
+    sim->trace = fopen(filename, "a+"); /* apend file (add text to a file or create a file if it does not exist.*/
+    assert(sim->trace != NULL);
+  }
+
+  //every simulation gets its own copy of the machine state
+  sim->topology = topo;
+  sim->num_cpus = topo->num_cpus;
+  sim->num_nodes = topo->num_nodes;
+  sim->cpus = malloc(sizeof(struct cpu) * topo->num_cpus);
+  sim->nodes = malloc(sizeof(struct node) * topo->num_nodes);
+  assert(sim->cpus != NULL && sim->nodes != NULL);
+  memcpy(sim->cpus, topo->cpus, sizeof(struct cpu) * topo->num_cpus);
+  memcpy(sim->nodes, topo->nodes, sizeof(struct node) * topo->num_nodes);
+
+  sim->cpu_set_words = CPU_SET_WORDS(sim->num_cpus);
+  sim->idle_cpus = cpu_set_new(sim->cpu_set_words);
+  sim->node_cpus = malloc(sizeof(CpuSet *) * sim->num_nodes);
+  assert(sim->node_cpus != NULL);
+  for(i = 0; i < sim->num_nodes; i++) sim->node_cpus[i] = cpu_set_new(sim->cpu_set_words);
+  for(i = 0; i < sim->num_cpus; i++) {
+    cpu_set_add(sim->idle_cpus, i);
+    cpu_set_add(sim->node_cpus[sim->cpus[i].node], i);
+  }
+
+  if(sort == GANG_SORT) setup_gangs(sim);
+  return sim;
+}
 
 /**
- * Represents a process to be stored in a Queue
- *
- * pid: process id
- * start: start time
- * total: total amount of cpu time
- * iofreq: how many seconds between each io operation
- * iodur: duration of io operations
- * remaining: remaining amount of cpu time to execute
- * last_start: last time the process was started
- * last_io_start: last time the process did io
- * rr: round robin frequency
+ * Frees a simulation with all of its processes and closes its trace
+ * @param sim the simulation
  */
-struct process {
-    int pid;
-    int start;
-    int total;
-    int iofreq;
-    int iodur;
-    int remaining;
-    int last_start;
-    int last_io_start;
-    int rr;
-};
+void simulation_free(Simulation * sim) {
+  int i;
 
-typedef struct process Process;
+  if(sim->metrics != NULL) metrics_close(sim); //the last window still looks at the queues
+  if(sim->source != NULL) source_close(sim);
+  if(sim->periodic != NULL) periodic_free(sim);
+  realloc_q(sim->all, sim->ready, sim->running, sim->waiting, sim->terminated);
+  g_queue_free_full(sim->rejected, free);
+  if(sim->trace != NULL) fclose(sim->trace);
+  if(sim->trace_index != NULL) trace_index_close(sim->trace_index);
+  if(sim->ztrace != NULL) trace_writer_close(sim->ztrace);
+  g_array_free(sim->ready_heap, TRUE);
+  for(i = 0; i < NUM_TIMERS; i++) g_array_free(sim->timers[i], TRUE);
+  if(sim->events != NULL) g_array_free(sim->events, TRUE);
+  if(sim->replay != NULL) replay_close(sim->replay);
+  if(sim->gangs != NULL) g_hash_table_destroy(sim->gangs);
+  if(sim->dependencies != NULL) dependencies_free(sim->dependencies);
+  if(sim->locks != NULL) locks_free(sim->locks);
+  for(i = 0; i < sim->num_nodes; i++) free(sim->node_cpus[i]);
+  free(sim->node_cpus);
+  free(sim->idle_cpus);
+  free(sim->cpus);
+  free(sim->nodes);
+  free(sim);
+}
 
 /**
- * FCFS Sorting Algorithm: Compares 2 processes in a queue based on their time of arrival
- * @param  a    First process
- * @param  b    Second process
- * @param  data data (typically NULL in this case)
- * @return      a negative value if a < b, 0 if a = b, a positive value if a > b
+ * Starts the trace of a simulation run: text appended to a file (indexed in the file with ".tix"
+ * appended with TRACE_INDEX, and also with ".pix" appended with TRACE_PID_INDEX), or with
+ * TRACE_COMPRESS a compressed trace in the file with ".gz" appended (and its block index with
+ * ".gz.idx")
+ * @param sim      the simulation
+ * @param filename name of the trace
+ * @param title    first line of the trace
  */
-gint sort_fcfs(gconstpointer a, gconstpointer b, gpointer data) {
-  Process * ap = (Process *) a;
-  Process * bp = (Process *) b;
-  return ap->start - bp->start; // sort so head is the least start time
+void open_trace(Simulation * sim, const char * filename, const char * title) {
+  char * compressed;
+
+  if(TRACE_COMPRESS) {
+    compressed = g_strconcat(filename, ".gz", NULL);
+    sim->ztrace = trace_writer_open(compressed, title);
+    g_free(compressed);
+    return;
+  }
+  write_to_file(filename, title);
+  write_to_file(filename, TRACE_HEADER);
+  sim->trace = fopen(filename, "a+"); /* apend file (add text to a file or create a file if it does not exist.*/
+  assert(sim->trace != NULL);
+  if(TRACE_INDEX || TRACE_PID_INDEX) sim->trace_index = trace_index_open(filename, sim->trace);
 }
 
 /**
- * Shortest Job First: Compares 2 processes in a queue based on their execution time
- * @param  a    First process
- * @param  b    Second process
- * @param  data unused var
- * @return      a negative value if a < b, 0 if a = b, a positive value if a > b
+ * I/O time of the bursts of a burst program that end within some cpu time. A time slice running
+ * out puts the cpu burst of a process back to its start, so the program never gets past a cpu
+ * burst as long as the time slice.
+ * @param  b   the program
+ * @param  cpu the cpu time
+ * @param  rr  the time slice
+ * @return     the I/O time
  */
-gint sort_sjf(gconstpointer a, gconstpointer b, gpointer data) {
-  Process * ap = (Process *) a;
-  Process * bp = (Process *) b;
-  return ap->total - bp->total; // sort so head is least total first
+gint64 program_io(const struct burst_program * b, gint64 cpu, int rr) {
+  gint64 io = 0, n;
+  guint i;
+
+  for(i = 0; i < b->count && b->phases[i].cpu < rr; i++) {
+    n = MIN(b->phases[i].count, cpu / b->phases[i].cpu);
+    cpu -= n * b->phases[i].cpu;
+    io += n * b->phases[i].io;
+    if(n < b->phases[i].count) break;
+  }
+  return io;
 }
 
 /**
- * Shortest Remaining Time First: Compares 2 processes in a queue based on their remaining execution time
- * @param  a    First process
- * @param  b    Second process
- * @param  data unused var
- * @return      a negative value if a < b, 0 if a = b, a positive value if a > b
+ * Upper bound on the time a process keeps a single cpu busy or spends waiting for I/O: each I/O
+ * uses up iofreq of its cpu time, so it does at most total / iofreq of them (or the I/O of the
+ * bursts of its burst program that fit in total)
+ * @param  p the process
+ * @return   the bound, G_MAXINT64 if an I/O never completes
  */
-gint sort_srtf(gconstpointer a, gconstpointer b, gpointer data) {
-  Process * ap = (Process *) a;
-  Process * bp = (Process *) b;
-  return ap->remaining - bp->remaining; // sort so head is least remaining time first
+gint64 busy_demand(Process * p) {
+  gint64 io = p->tmpl->iofreq == INT_MAX ? 0 : p->tmpl->total / p->tmpl->iofreq;
+
+  if(p->tmpl->program != NULL) return p->tmpl->total + program_io(p->tmpl->program, p->tmpl->total, INT_MAX);
+
+  if(io > 0 && p->tmpl->iodur == INT_MAX) return G_MAXINT64;
+  return p->tmpl->total + io * p->tmpl->iodur;
 }
 
-gint (*fcfs_algorithm)(gconstpointer,gconstpointer,gpointer);
-gint (*sjf_algorithm)(gconstpointer,gconstpointer,gpointer);
-gint (*srtf_algorithm)(gconstpointer,gconstpointer,gpointer);
+/**
+ * Sets up the dependencies of a simulation as a graph of jobs (see struct dependencies) and
+ * finds its critical path. Dependencies on or of pids without processes are ignored. Jobs in a
+ * cycle, and the jobs after them, never start.
+ * @param sim   the simulation, with all its processes in the all queue
+ * @param edges the dependencies, as struct dependency
+ */
+void setup_dependencies(Simulation * sim, GArray * edges) {
+  struct dependencies * d = calloc(1, sizeof(struct dependencies));
+  struct dependency * e;
+  gint64 * arrival_end, * longest, * release, end = G_MININT64, demand, t;
+  guint * order, * left, i, j, k, m, n;
+  GList * l;
+
+  assert(d != NULL);
+  sim->dependencies = d;
+  d->jobs = g_hash_table_new(g_direct_hash, g_direct_equal);
+  for(i = 0; i < edges->len; i++) {
+    e = &g_array_index(edges, struct dependency, i);
+    if(dependency_job(d, e->pid) == 0) g_hash_table_insert(d->jobs, GINT_TO_POINTER(e->pid), GUINT_TO_POINTER(++d->count));
+    if(dependency_job(d, e->parent) == 0) g_hash_table_insert(d->jobs, GINT_TO_POINTER(e->parent), GUINT_TO_POINTER(++d->count));
+  }
+  n = d->count;
+  d->first = calloc(n + 1, sizeof(guint));
+  d->pending = calloc(n, sizeof(guint));
+  d->live = calloc(n, sizeof(guint));
+  d->held = calloc(n, sizeof(GList *));
+  arrival_end = malloc(n * sizeof(gint64)); //latest arrival plus busy_demand() of the job's processes
+  longest = calloc(n, sizeof(gint64)); //largest busy_demand() of the job's processes
+  release = malloc(n * sizeof(gint64)); //earliest time the job's parents can all finish
+  order = malloc(n * sizeof(guint));
+  left = malloc(n * sizeof(guint));
+  assert(d->first != NULL && d->pending != NULL && d->live != NULL && d->held != NULL && arrival_end != NULL
+    && longest != NULL && release != NULL && order != NULL && left != NULL);
+  for(j = 0; j < n; j++) arrival_end[j] = release[j] = G_MININT64;
+
+  d->first_start = g_queue_is_empty(sim->all) ? INITIAL_TIME : ((Process *) sim->all->head->data)->start;
+  for(l = sim->all->head; l != NULL; l = l->next) {
+    Process * p = l->data;
+    demand = busy_demand(p);
+    t = demand > G_MAXINT64 - p->start ? G_MAXINT64 : p->start + demand;
+    if((j = dependency_job(d, p->pid)) == 0) end = MAX(end, t);
+    else {
+      d->live[j - 1]++;
+      arrival_end[j - 1] = MAX(arrival_end[j - 1], t);
+      longest[j - 1] = MAX(longest[j - 1], demand);
+    }
+  }
+
+  //compressed sparse rows: count the successors of each job, then place them
+  for(i = 0; i < edges->len; i++) {
+    e = &g_array_index(edges, struct dependency, i);
+    j = dependency_job(d, e->parent) - 1;
+    k = dependency_job(d, e->pid) - 1;
+    if(d->live[j] == 0 || d->live[k] == 0) continue;
+    d->first[j + 1]++;
+    d->pending[k]++;
+    d->edges++;
+  }
+  for(j = 0; j < n; j++) d->first[j + 1] += d->first[j];
+  d->successors = malloc(MAX(d->edges, 1) * sizeof(guint));
+  assert(d->successors != NULL);
+  memcpy(left, d->first, n * sizeof(guint)); //next free place in each row
+  for(i = 0; i < edges->len; i++) {
+    e = &g_array_index(edges, struct dependency, i);
+    j = dependency_job(d, e->parent) - 1;
+    k = dependency_job(d, e->pid) - 1;
+    if(d->live[j] == 0 || d->live[k] == 0) continue;
+    d->successors[left[j]++] = k;
+  }
+
+  //critical path: jobs in topological order, each finishing as early as its arrivals and parents allow
+  memcpy(left, d->pending, n * sizeof(guint));
+  for(j = 0, k = 0; j < n; j++) {
+    if(d->live[j] > 0 && left[j] == 0) order[k++] = j;
+  }
+  for(i = 0; i < k; i++) {
+    j = order[i];
+    t = release[j] == G_MININT64 ? G_MININT64 : longest[j] > G_MAXINT64 - release[j] ? G_MAXINT64 : release[j] + longest[j];
+    t = MAX(t, arrival_end[j]);
+    end = MAX(end, t);
+    for(m = d->first[j]; m < d->first[j + 1]; m++) {
+      release[d->successors[m]] = MAX(release[d->successors[m]], t);
+      if(--left[d->successors[m]] == 0) order[k++] = d->successors[m];
+    }
+  }
+  d->critical_path = end == G_MININT64 ? 0 : end == G_MAXINT64 ? G_MAXINT64 : end - d->first_start;
+  free(arrival_end);
+  free(longest);
+  free(release);
+  free(order);
+  free(left);
+}
 
 /**
- * Initializes a process with passed in paramaters
- * @param  pid    Process' PID
- * @param  start  start time
- * @param  total  Total execution time
- * @param  iofreq how oftem the process does I/O
- * @param  iodur  I/O duration time
- * @return        pointer to the initialized variable
+ * A point of a lock script being put in order
+ *
+ * at: cpu time of the process at the point
+ * kind: 0 for a release, 1 for an acquire, 2 for the release of a section of length 0
+ * order: the section of the point, in input order
  */
-Process * process_new(int pid, int start, int total, int iofreq, int iodur, int rr) {
-  Process *p = malloc(sizeof(Process));
-  assert (p != NULL);
-  p->pid = pid; //process id
-  p->start = start; //start time
-  p->total = total; //total amount of cpu time
-  p->iofreq = iofreq; //how many seconds between each io operation
-  p->iodur = iodur; //duration of io operations
-  p->remaining = total; //remaining amount of cpu time to execute
-  p->rr = rr; //round robin frequency
-  return p;
+struct lock_point_order {
+    int at;
+    int kind;
+    guint order;
+};
+
+/**
+ * Orders the points of a lock script: by cpu time, then releases before acquires, so that back to
+ * back sections of a lock do not block on themselves, then in input order
+ * @param  a First point
+ * @param  b Second point
+ * @return   a negative value if a < b, 0 if a = b, a positive value if a > b
+ */
+int compare_lock_points(const void * a, const void * b) {
+  const struct lock_point_order * x = a, * y = b;
+
+  if(x->at != y->at) return x->at < y->at ? -1 : 1;
+  if(x->kind != y->kind) return x->kind - y->kind;
+  return x->order < y->order ? -1 : x->order > y->order;
 }
 
-char * get_state_string(int state) {
-  switch(state) {
-    case READY_STATE:
-      return READY_STATE_STR;
-    break;
+/**
+ * Sets up the locks of a simulation and the lock scripts of its processes from the L and C lines
+ * of its workload: the sections of each pid become a script of acquire and release points, in
+ * order of cpu time, shared by the processes with that pid
+ * @param sim   the simulation, with all its processes in the all queue
+ * @param locks the locks and critical sections
+ */
+void setup_locks(Simulation * sim, struct lock_spec * locks) {
+  struct locks * k = calloc(1, sizeof(struct locks));
+  GHashTable * ids = g_hash_table_new(g_direct_hash, g_direct_equal); //lock id --> number + 1
+  GHashTable * pids = g_hash_table_new(g_direct_hash, g_direct_equal); //pid --> number + 1
+  struct critical_section * c;
+  struct lock_units * u;
+  struct lock_point_order * order;
+  guint * first, * next, * acquire, i, j, n, m, scripted = 0;
+  GList * l;
 
-    case RUNNING_STATE:
-      return RUNNING_STATE_STR;
-    break;
+  assert(k != NULL);
+  sim->locks = k;
+  for(i = 0; i < locks->units->len + locks->sections->len; i++) {
+    int id = i < locks->units->len ? g_array_index(locks->units, struct lock_units, i).lock
+      : g_array_index(locks->sections, struct critical_section, i - locks->units->len).lock;
+    if(g_hash_table_lookup(ids, GINT_TO_POINTER(id)) == NULL) g_hash_table_insert(ids, GINT_TO_POINTER(id), GUINT_TO_POINTER(++k->count));
+  }
+  k->locks = calloc(MAX(k->count, 1), sizeof(struct lock));
+  assert(k->locks != NULL);
+  for(i = 0; i < k->count; i++) k->locks[i].units = 1;
+  for(i = 0; i < locks->units->len; i++) {
+    u = &g_array_index(locks->units, struct lock_units, i);
+    k->locks[GPOINTER_TO_UINT(g_hash_table_lookup(ids, GINT_TO_POINTER(u->lock))) - 1].units = MAX(u->units, 1);
+  }
+  for(i = 0; i < k->count; i++) {
+    k->locks[i].mutex = k->locks[i].units == 1;
+    k->locks[i].waiters = g_queue_new();
+    k->locks[i].keys = g_array_new(FALSE, FALSE, sizeof(struct waiter_key));
+  }
 
-    case WAITING_STATE:
-      return WAITING_STATE_STR;
-    break;
+  //the sections of each pid, in input order: count them, then place them
+  n = 0;
+  for(i = 0; i < locks->sections->len; i++) {
+    c = &g_array_index(locks->sections, struct critical_section, i);
+    if(g_hash_table_lookup(pids, GINT_TO_POINTER(c->pid)) == NULL) g_hash_table_insert(pids, GINT_TO_POINTER(c->pid), GUINT_TO_POINTER(++n));
+  }
+  first = calloc(n + 1, sizeof(guint));
+  next = malloc(MAX(n, 1) * sizeof(guint));
+  m = locks->sections->len;
+  order = malloc(MAX(m, 1) * 2 * sizeof(struct lock_point_order));
+  acquire = malloc(MAX(m, 1) * sizeof(guint)); //where the acquire point of each section ends up in its script
+  k->points = malloc(MAX(m, 1) * 2 * sizeof(struct lock_point));
+  assert(first != NULL && next != NULL && order != NULL && acquire != NULL && k->points != NULL);
+  for(i = 0; i < m; i++) {
+    c = &g_array_index(locks->sections, struct critical_section, i);
+    first[GPOINTER_TO_UINT(g_hash_table_lookup(pids, GINT_TO_POINTER(c->pid)))] += 2;
+  }
+  for(j = 0; j < n; j++) first[j + 1] += first[j];
+  memcpy(next, first, n * sizeof(guint));
+  for(i = 0; i < m; i++) {
+    c = &g_array_index(locks->sections, struct critical_section, i);
+    j = GPOINTER_TO_UINT(g_hash_table_lookup(pids, GINT_TO_POINTER(c->pid))) - 1;
+    order[next[j]++] = (struct lock_point_order) { MAX(c->at, 0), 1, i };
+    order[next[j]++] = (struct lock_point_order) { c->length > INT_MAX - MAX(c->at, 0) ? INT_MAX : MAX(c->at, 0) + MAX(c->length, 0),
+      c->length > 0 ? 0 : 2, i };
+  }
+  for(j = 0; j < n; j++) {
+    qsort(order + first[j], first[j + 1] - first[j], sizeof(struct lock_point_order), compare_lock_points);
+    for(i = first[j]; i < first[j + 1]; i++) {
+      c = &g_array_index(locks->sections, struct critical_section, order[i].order);
+      k->points[i].at = order[i].at;
+      k->points[i].lock = GPOINTER_TO_UINT(g_hash_table_lookup(ids, GINT_TO_POINTER(c->lock))) - 1;
+      if(order[i].kind == 1) acquire[order[i].order] = i - first[j];
+      k->points[i].acquire = order[i].kind == 1 ? i - first[j] : acquire[order[i].order]; //acquires sort first
+    }
+  }
 
-    case TERMINATED_STATE:
-      return TERMINATED_STATE_STR;
-    break;
+  //every process of a pid with sections runs its own copy of the script
+  for(l = sim->all->head; l != NULL; l = l->next) {
+    if(g_hash_table_lookup(pids, GINT_TO_POINTER(((Process *) l->data)->pid)) != NULL) scripted++;
+  }
+  k->states = calloc(MAX(scripted, 1), sizeof(struct lock_state));
+  k->scripts = g_hash_table_new(g_direct_hash, g_direct_equal);
+  assert(k->states != NULL);
+  for(l = sim->all->head, i = 0; l != NULL; l = l->next) {
+    j = GPOINTER_TO_UINT(g_hash_table_lookup(pids, GINT_TO_POINTER(((Process *) l->data)->pid)));
+    if(j-- == 0) continue;
+    k->states[i].points = k->points + first[j];
+    k->states[i].count = first[j + 1] - first[j];
+    k->states[i].boost = NO_BOOST;
+    k->states[i].position = NO_POSITION;
+    g_hash_table_insert(k->scripts, l->data, &k->states[i++]);
+  }
+  g_hash_table_destroy(ids);
+  g_hash_table_destroy(pids);
+  free(first);
+  free(next);
+  free(order);
+  free(acquire);
+}
 
-    case NEW_STATE:
-      return NEW_STATE_STR;
-    break;
+/**
+ * Sets up the periodic tasks of a simulation from the R lines of its workload, and queues the
+ * first job of each. Tasks with the pid of a task before them are left out, jobs are told apart
+ * by their pid.
+ * @param sim     the simulation, with all its processes in the all queue
+ * @param tasks   the tasks, as struct periodic_task
+ * @param horizon no job is released at or after it
+ */
+void setup_periodic(Simulation * sim, GArray * tasks, int horizon) {
+  struct periodic * r = calloc(1, sizeof(struct periodic));
+  struct periodic_task * t;
+  gint64 lcm = 1, a, b, c;
+  int deadline = 0;
+  guint i;
 
-    default:
-      return UNKNOWN_STATE_STR;
-    break;
+  assert(r != NULL);
+  sim->periodic = r;
+  r->tasks = malloc(MAX(tasks->len, 1) * sizeof(struct periodic_task));
+  r->phases = malloc(MAX(tasks->len, 1) * sizeof(int));
+  r->by_pid = g_hash_table_new(g_direct_hash, g_direct_equal);
+  r->ready = g_array_new(FALSE, FALSE, sizeof(int));
+  r->events = g_array_new(FALSE, FALSE, sizeof(TraceEvent));
+  assert(r->tasks != NULL && r->phases != NULL);
+  r->horizon = horizon;
+  r->window = -1;
+  for(i = 0; i < tasks->len; i++) {
+    t = &g_array_index(tasks, struct periodic_task, i);
+    if(g_hash_table_lookup(r->by_pid, GINT_TO_POINTER(t->pid)) != NULL) continue;
+    r->tasks[r->count] = *t;
+    g_hash_table_insert(r->by_pid, GINT_TO_POINTER(t->pid), GUINT_TO_POINTER(++r->count));
   }
+  for(i = 0; i < r->count; i++) {
+    t = &r->tasks[i];
+    t->tmpl = periodic_template(t->wcet, t->period, t->deadline);
+    r->utilization += (double) t->wcet / t->period;
+    deadline = MAX(deadline, t->deadline);
+    if(lcm > 0) { //the least common multiple of the periods, given up on past the horizon
+      for(a = lcm, b = t->period; b != 0; a = b, b = c) c = a % b;
+      lcm = lcm / a * t->period <= horizon ? lcm / a * t->period : 0;
+    }
+    t->next = t->offset;
+    if(t->offset < horizon) {
+      periodic_queue(sim, t);
+      r->pending++;
+    }
+    else t->next = INT_MAX;
+  }
+  //EDF keys past INT_MAX are cut short, and would not move ahead with the hyperperiods
+  r->hyperperiod = r->count > 0 && (gint64) horizon + deadline <= INT_MAX ? lcm : 0;
 }
 
-void write_update(const char * filename, int tot, int pid, int old, int new) {
-  FILE *file;
+/**
+ * Tells whether the busy periods of a simulation can be simulated on their own: with one cpu and
+ * no dispatch costs nothing carries over an idle gap, since the cpu and every queue are empty.
+ * Gang scheduling, streaming metrics, dependencies, locks, periodic tasks and the token bucket are
+ * left out, they look beyond a busy period.
+ * @param  sim the simulation, not started yet
+ * @return     TRUE if its busy periods are independent
+ */
+gboolean busy_periods_independent(Simulation * sim) {
+  return sim->num_cpus == 1 && sim->num_nodes == 1 && sim->sort != GANG_SORT && sim->metrics == NULL
+    && DISPATCH_COST == 0 && CONTEXT_SWITCH_COST == 0 && CACHE_WARMUP_COST == 0 && TOKEN_RATE == 0
+    && sim->dependencies == NULL && sim->locks == NULL && sim->periodic == NULL;
+}
 
-  file = fopen(filename,"a+"); /* apend file (add text to a file or create a file if it does not exist.*/
-  fprintf(file, "%d\t%d\t%s\t\t%s\n", tot, pid, get_state_string(old), get_state_string(new)); //writes
-  fclose(file);
+/**
+ * Tells whether a simulation is to be sharded
+ * @param  sim the simulation, not started yet
+ * @return     TRUE if the simulation can be sharded
+ */
+gboolean shard_possible(Simulation * sim) {
+  return SHARD_BUSY_PERIODS && busy_periods_independent(sim) && sim->source == NULL;
 }
 
 /**
- * Writes results to a file
- * @param filename name of file
- * @param val      what to write (append)
+ * Simulates a shard, on a worker thread
+ * @param data the shard
+ * @param user unused
  */
-void write_to_file(const char * filename, const char * val) {
-  FILE *file;
+void shard_run(gpointer data, gpointer user) {
+  struct shard * s = data;
+  int t = s->start;
 
-  file = fopen(filename,"a+"); /* apend file (add text to a file or create a file if it does not exist.*/
-  fprintf(file, "%s", val); //writes
-  fclose(file); //done writing to file
+  while((t = get_next_move(s->sim, t)) != INVALID_MOVE);
 }
 
 /**
- * Creates a queue of processes from the text input data
- * @param  filename name of file
- * @return          queue of processes
+ * Splits a workload into shards at the idle gaps that start busy periods. A busy period lasts
+ * at most the busy_demand() of its processes past the arrivals, as the cpu only idles while every
+ * arrived process waits for I/O; a process arriving later than that starts a new one.
+ * @param  all the processes, in order of arrival
+ * @param  min fewest processes of a shard (but the last)
+ * @return     number of processes of each shard
  */
-GQueue * parse_file(const char * filename) {
-  GQueue * queue;
-  FILE * fp;
-  int pid, start, total, iofreq, iodur, rr;
+GArray * shard_sizes(GQueue * all, guint min) {
+  GArray * sizes = g_array_new(FALSE, FALSE, sizeof(guint));
+  gint64 end = G_MININT64, demand;
+  guint count = 0;
+  GList * l;
 
-  queue = g_queue_new();
+  for(l = all->head; l != NULL; l = l->next) {
+    Process * p = l->data;
 
-  if((fp = fopen(filename, "r+")) == NULL) {
-    printf("No such file\n");
-    exit(1);
+    if(p->start > end && count >= min) {
+      g_array_append_val(sizes, count);
+      count = 0;
+    }
+    end = MAX(end, p->start);
+    demand = busy_demand(p);
+    end = demand > G_MAXINT64 - end ? G_MAXINT64 : end + demand;
+    count++;
   }
+  if(count > 0) g_array_append_val(sizes, count);
+  return sizes;
+}
 
-  while(fscanf(fp,"%d,%d,%d,%d,%d,%d", &pid, &start, &total, &iofreq, &iodur, &rr) == 6) {
+/**
+ * Runs a simulation to the end. With SHARD_BUSY_PERIODS the busy periods of the workload are
+ * simulated in parallel and their transitions replayed into the simulation in order, which
+ * gives the trace and stats of the sequential run.
+ * @param sim the simulation, not started yet
+ */
+void simulation_run(Simulation * sim) {
+  GArray * sizes = shard_possible(sim) ? shard_sizes(sim->all, SHARD_MIN_PROCESSES) : NULL;
+  struct shard * shards;
+  GThreadPool * pool;
+  GQueue * q;
+  Process * p;
+  guint i, j, n = sizes != NULL ? sizes->len : 0;
+  int t = INITIAL_TIME;
 
-    iofreq = iofreq <= 0 ? INT_MAX : iofreq; // assume to be no I/O if given negative or 0 (happens only at max simulation time)
-    iodur = iodur <= 0 ? INT_MAX : iodur; //assume to be no I/O if given negative or 0 (happens only at max simulation time)
-    rr = rr <= 0 ? INT_MAX : rr; // assume to be no preemption if given negative or 0 (happens only at max simulation time)
-    total = total < 0 ? 0 : total; //assume to be zero if given negative value
-    start = start < 0 ? 0 : start; //assume to be zero if given negative value
+  if(n < 2) {
+    if(sizes != NULL) g_array_free(sizes, TRUE);
+    while((t = get_next_move(sim, t)) != INVALID_MOVE);
+    return;
+  }
 
-    Process *p = process_new(pid, start, total, iofreq, iodur, rr);
-    g_queue_push_head(queue, p);
+  shards = calloc(n, sizeof(struct shard));
+  assert(shards != NULL);
+  pool = g_thread_pool_new(shard_run, NULL, SHARD_WORKERS, TRUE, NULL);
+  for(i = 0; i < n; i++) {
+    q = g_queue_new();
+    for(j = 0; j < g_array_index(sizes, guint, i); j++) g_queue_push_tail(q, g_queue_pop_head(sim->all));
+    shards[i].start = ((Process *) g_queue_peek_head(q))->start;
+    shards[i].sim = simulation_new(sim->topology, q, sim->sort, NULL);
+    shards[i].sim->engine = sim->engine;
+    shards[i].sim->events = g_array_new(FALSE, FALSE, sizeof(TraceEvent));
+    g_thread_pool_push(pool, &shards[i], NULL);
   }
+  g_thread_pool_free(pool, FALSE, TRUE);
 
-  if(feof(fp)) {
-    printf("Finished processing %s\n", filename);
-    return queue;
+  for(i = 0; i < n; i++) {
+    Simulation * s = shards[i].sim;
+
+    account_idle_cpus(sim, t, shards[i].start); //the gap before the shard
+    for(j = 0; j < s->events->len; j++) {
+      TraceEvent * e = &g_array_index(s->events, TraceEvent, j);
+      record_move(sim, e->time, e->pid, e->old_state, e->new_state);
+    }
+    while((p = g_queue_pop_head(s->terminated)) != NULL) {
+      g_queue_push_tail(sim->terminated, p);
+      if(sim->on_terminate != NULL) sim->on_terminate(sim, p, sim->data);
+    }
+    while((p = g_queue_pop_head(s->rejected)) != NULL) g_queue_push_tail(sim->rejected, p);
+    //processes stuck in I/O for good stay where they are, the simulation owns them from now on
+    while((p = g_queue_pop_head(s->ready)) != NULL) g_queue_push_tail(sim->ready, p);
+    while((p = g_queue_pop_head(s->running)) != NULL) g_queue_push_tail(sim->running, p);
+    while((p = g_queue_pop_head(s->waiting)) != NULL) g_queue_push_tail(sim->waiting, p);
+
+    sim->stats.dispatches += s->stats.dispatches;
+    sim->stats.context_switches += s->stats.context_switches;
+    sim->stats.overhead_time += s->stats.overhead_time;
+    sim->stats.work += s->stats.work;
+    sim->stats.idle_time += s->stats.idle_time;
+    sim->stats.waste_time += s->stats.waste_time;
+    sim->stats.rejected += s->stats.rejected;
+    sim->stats.rejected_work += s->stats.rejected_work;
+    sim->stats.end_time = s->stats.end_time;
+    t = s->stats.end_time;
+    simulation_free(s);
   }
+  free(shards);
+  g_array_free(sizes, TRUE);
+}
+
+/**
+ * Adds a process to a workload summary
+ * @param s the summary
+ * @param p the process
+ */
+void summary_add(struct workload_summary * s, Process * p) {
+  int b = histogram_bucket(p->tmpl->total), order;
+  double gap, t = p->tmpl->total;
+
+  if(s->count == 0) s->first_start = s->last_start = p->start;
   else {
-    printf("Error reading! Invalid format!\n");
-    return queue;
+    gap = (double) p->start - s->prev_start;
+    order = gap > 0 ? 1 : gap < 0 ? -1 : 0;
+    if(s->order == 0) s->order = order;
+    else if(order != 0 && order != s->order) s->order = APPROX_UNORDERED;
+    s->gaps += gap < 0 ? -gap : gap;
+    s->gaps2 += gap * gap;
   }
+  s->first_start = MIN(s->first_start, p->start);
+  s->last_start = MAX(s->last_start, p->start);
+  s->prev_start = p->start;
+  s->count++;
+
+  //a process does I/O after every iofreq of cpu time unless its time slice runs out first
+  if(p->tmpl->program != NULL) s->io += p->tmpl->total > 0 ? program_io(p->tmpl->program, p->tmpl->total - 1, p->tmpl->rr) : 0;
+  else if(p->tmpl->iofreq < p->tmpl->rr && p->tmpl->iodur != INT_MAX && p->tmpl->total > 0) s->io += (double) ((p->tmpl->total - 1) / p->tmpl->iofreq) * p->tmpl->iodur;
+  s->sizes[b]++;
+  if(p->tmpl->total > MIN(burst_cpu(p), p->tmpl->rr)) s->sliced[b]++;
+  s->work[b] += t;
+  s->work2[b] += t * t;
 }
 
 /**
- * Print the size of the queue
- * @param q queue
+ * Summarizes the text input data of a workload, one record at a time, so that workloads of any
+ * size fit in memory
+ * @param  filename name of file
+ * @return          the summary, NULL if the file can not be read
  */
-void print_size_of_queue(GQueue * q) {
-  printf("%d\n", (int) g_queue_get_length(q));
+struct workload_summary * summarize_file(const char * filename) {
+  struct workload_summary * s;
+  GHashTable * templates;
+  char line[MAX_LINE];
+  Process * p;
+  FILE * fp;
+  int fields;
+
+  if((fp = fopen(filename, "r")) == NULL) return NULL;
+  s = calloc(1, sizeof(struct workload_summary));
+  assert(s != NULL);
+  templates = g_hash_table_new(g_direct_hash, g_direct_equal);
+  while(fgets(line, sizeof(line), fp) != NULL) {
+    p = NULL;
+    fields = parse_process(line, templates, &p);
+    if(fields == EOF || fields == RECORD_TEMPLATE) continue; //blank line or template
+    if(fields < 6) break;
+    summary_add(s, p);
+    free(p);
+  }
+  g_hash_table_destroy(templates);
+  fclose(fp);
+  return s;
 }
 
 /**
- * moves a process from the head of a non-empty queue to the tail of another queue
- * @param from SOURCE queue
- * @param to   DESTINATION queue
+ * Gets the probability that an arrival has to wait in an M/M/c queue (Erlang C)
+ * @param  c    number of cpus
+ * @param  load offered load, in cpus
+ * @return      the probability, 1 when the cpus can not keep up
  */
-void move_process(GQueue * from, GQueue * to) {
-  assert(!g_queue_is_empty(from)); //from cannot be empty
-  g_queue_push_tail(to, g_queue_pop_head(from));
+double erlang_c(int c, double load) {
+  double b = 1; //Erlang B, by its recurrence over the number of cpus
+  int k;
+
+  if(load >= c) return 1;
+  for(k = 1; k <= c; k++) b = load * b / (k + load * b);
+  return b / (1 - load / c * (1 - b));
 }
 
 /**
- * gets the start value of the process in a queue
- * @param  q the queue to do the operation on
- * @return   the start value of the process in a queue
+ * Estimates the mean turnaround, wait, makespan and utilization of a workload without
+ * simulating it. Arrivals are spread evenly over the arrival horizon of the summary, scaled up
+ * to the requested number of processes. While the cpus keep up the ready queue is a G/G/c queue:
+ * FCFS waits follow Allen-Cunneen, processes running in several bursts share the cpus like
+ * processor sharing, and SJF and SRTF follow the non-preemptive and preemptive size priority
+ * formulas (on one pooled cpu, per bucket of cpu time). Processes the cpus can not keep up with
+ * are modelled as a fluid: they are done once the work ahead of them drains at c per time unit.
+ * I/O is a pure delay, as if every process had its own device.
+ * @param  s         the workload summary
+ * @param  sort      the scheduling algorithm (gang scheduling is treated as FCFS)
+ * @param  c         number of cpus
+ * @param  processes number of processes to estimate for
+ * @return           the estimates
  */
-int get_head_start_val(GQueue * q) {
-  return ((Process *) g_queue_peek_head(q))->start;
+struct approximation approximate(const struct workload_summary * s, int sort, int c, gint64 processes) {
+  struct approximation r = { 0, 0, 0, 0 };
+  double m = s->count, n = processes, e1 = 0, e2 = 0, horizon, rate, load, ca2 = 1, cs2, gap;
+  double congestion, w0, fifo, backlog, smaller = 0, smaller2 = 0, larger = m, sigma_below, sigma;
+  double x, shared, shared_load, ps, np, pre, io = m > 0 ? s->io / m : 0;
+  gboolean overloaded;
+  int b;
+
+  if(s->count == 0) return r;
+  for(b = 0; b < METRICS_BUCKETS; b++) {
+    e1 += s->work[b];
+    e2 += s->work2[b];
+  }
+  e1 /= m;
+  e2 /= m;
+  cs2 = e1 > 0 ? e2 / (e1 * e1) - 1 : 0;
+  if(s->order != APPROX_UNORDERED && m > 2 && s->gaps > 0) { //arrivals in order: measured burstiness, else Poisson
+    gap = s->gaps / (m - 1);
+    ca2 = MAX(s->gaps2 / (m - 1) / (gap * gap) - 1, 0);
+  }
+  horizon = m > 1 ? (double) (s->last_start - s->first_start) * (n - 1) / (m - 1) : 0;
+  rate = horizon > 0 ? (n - 1) / horizon : 0;
+  load = rate * e1 / c;
+  overloaded = horizon == 0 || load >= 1;
+  congestion = overloaded ? 1 : erlang_c(c, load * c);
+  w0 = e1 > 0 ? congestion * e2 / (2 * c * e1) * (ca2 + 1) / 2 : 0; //wait for the cpus to free up
+  backlog = MAX(n * e1 / c - horizon, 0); //time to drain the work left when the arrivals end
+  fifo = overloaded ? backlog / 2 : congestion * e1 / (c * (1 - load)) * (ca2 + cs2) / 2;
+
+  for(b = 0; b < METRICS_BUCKETS; b++) {
+    if(s->sizes[b] == 0) continue;
+    x = s->work[b] / s->sizes[b];
+    sigma_below = rate * smaller / m / c; //load of the processes ahead of this bucket
+    sigma = sigma_below + rate * s->work[b] / m / c;
+    smaller2 += s->work2[b];
+    if(sort == SJF_SORT || sort == SRTF_SORT) {
+      if(horizon == 0 || sigma >= 1) { //starved until the work of the smaller processes drains
+        np = pre = MAX(x, n * (smaller + s->work[b] / 2) / m / c - horizon / 2);
+      }
+      else {
+        np = w0 / ((1 - sigma_below) * (1 - sigma)) + x;
+        pre = (load > 0 ? congestion / load : 0) * rate * smaller2 / m / (2.0 * c * c) * (ca2 + 1) / 2
+          / ((1 - sigma_below) * (1 - sigma)) + x * (1 + sigma_below / (c * (1 - sigma_below)));
+      }
+      //processes running in several bursts are overtaken by smaller arrivals between them
+      r.turnaround += s->sliced[b] * pre + (s->sizes[b] - s->sliced[b]) * np;
+    }
+    else {
+      shared = (smaller + x * larger) / m; //cpu time of the average process by the time this one has x
+      shared_load = overloaded ? rate * shared / c : load;
+      if(horizon == 0 || shared_load >= 1) ps = MAX(x, n * shared / c - horizon / 2);
+      else ps = x + x * erlang_c(c, shared_load * c) / (c * (1 - shared_load));
+      r.turnaround += s->sliced[b] * ps + (s->sizes[b] - s->sliced[b]) * (x + fifo);
+    }
+    smaller += s->work[b];
+    larger -= s->sizes[b];
+  }
+  r.turnaround = r.turnaround / m + io;
+  r.wait = MAX(r.turnaround - e1 - io, 0);
+  r.makespan = overloaded ? MAX(horizon, n * e1 / c) + io : horizon + r.turnaround;
+  r.utilization = r.makespan > 0 ? n * e1 / (c * r.makespan) : 0;
+  return r;
 }
 
 /**
- * Return the pid of the tail of the queue
- * @param  q the queue to do the operation on
- * @return   the pid of the tail of the queue
+ * Measures the mean turnaround, wait, makespan and utilization of a finished simulation
+ * @param  sim the simulation
+ * @return     the measured values
  */
-int get_tail_pid(GQueue * q) {
-  return ((Process *) g_queue_peek_tail(q))->pid;
+struct approximation simulation_measure(Simulation * sim) {
+  struct approximation r = { 0, 0, 0, 0 };
+  double first = INT_MAX, work = 0;
+  guint n = g_queue_get_length(sim->terminated);
+  GList * l;
+
+  for(l = sim->terminated->head; l != NULL; l = l->next) {
+    Process * p = l->data;
+    r.turnaround += p->finish - p->start;
+    r.wait += p->wait_time;
+    first = MIN(first, p->start);
+    work += p->tmpl->total;
+  }
+  if(n == 0) return r;
+  r.turnaround /= n;
+  r.wait /= n;
+  r.makespan = sim->stats.end_time - first;
+  r.utilization = r.makespan > 0 ? work / (sim->num_cpus * r.makespan) : 0;
+  return r;
 }
 
 /**
- * Get the IO duration of the tail of the queue
- * @param  q the queue to do the operation on
- * @return   the IO duration of the tail of the queue
+ * Gets the relative error of an estimate, in percent
+ * @param  estimate the estimate
+ * @param  exact    the exact value
+ * @return          the error
  */
-int get_tail_iodur(GQueue * q) {
-  return ((Process *) g_queue_peek_tail(q))->iodur;
+double approx_error(double estimate, double exact) {
+  return exact != 0 ? 100 * (estimate - exact) / exact : 0;
 }
 
 /**
- * Get the IO duration of the head of the queue
- * @param  q the queue to do the operation on
- * @return   the IO duration of the head of the queue
+ * Prints approximation mode estimates, or the exact values they are checked against
+ * @param name   name of the scheduling algorithm
+ * @param what   "approximation" or "exact"
+ * @param r      the values
+ * @param micros time taken to get them, in microseconds
  */
-int get_head_iodur(GQueue * q) {
-  return ((Process *) g_queue_peek_head(q))->iodur;
+void print_approximation(const char * name, const char * what, struct approximation r, gint64 micros) {
+  printf("%s %s (%.3f ms): turnaround %.1f, wait %.1f, makespan %.0f, utilization %.3f\n", name, what,
+    micros / 1000.0, r.turnaround, r.wait, r.makespan, r.utilization);
 }
 
 /**
- * Get the IO frequency of the head of the queue
- * @param  q the queue to do the operation on
- * @return   the IO frequency of the head of the queue
+ * A parsed workload kept in memory by the simulation server
+ *
+ * procs: the processes of the workload in input order, copied into every simulation of it
+ * refs: references held by the workload cache and by running simulations
  */
-int get_head_iofreq_val(GQueue * q) {
-  return ((Process *) g_queue_peek_head(q))->iofreq;
-}
+struct workload {
+    GArray * procs;
+    int refs;
+};
+
+typedef struct workload Workload;
+
+GHashTable * workloads; //workload cache: name --> Workload
+GMutex workloads_lock; //guards the workload cache and the reference counts
 
 /**
- * Get the IO frequency of the tail of the queue
- * @param  q the queue to do the operation on
- * @return   the IO frequency of the tail of the queue
+ * Drops a reference to a workload, freeing it with the last one
+ * @param w the workload
  */
-int get_tail_iofreq_val(GQueue * q) {
-  return ((Process *) g_queue_peek_tail(q))->iofreq;
+void workload_unref(Workload * w) {
+  gboolean last;
+
+  g_mutex_lock(&workloads_lock);
+  last = --w->refs == 0;
+  g_mutex_unlock(&workloads_lock);
+  if(last) {
+    g_array_free(w->procs, TRUE);
+    free(w);
+  }
 }
 
 /**
- * Get the next IO time of the head of the queue
- * @param  q            the queue
- * @param  current_time current time
- * @return              the next IO time of the head of the queue
+ * Finds a workload in the cache
+ * @param  name name of the workload
+ * @return      the workload with a reference taken for the caller, NULL if not cached
  */
-int get_next_io_time(GQueue * q, int current_time) {
-  return get_head_last_start(q) + get_head_iofreq_val(q);
+Workload * workload_lookup(const char * name) {
+  Workload * w;
+
+  g_mutex_lock(&workloads_lock);
+  w = g_hash_table_lookup(workloads, name);
+  if(w != NULL) w->refs++;
+  g_mutex_unlock(&workloads_lock);
+  return w;
 }
 
 /**
- * Get the remaining cpu time of the tail of the queue
- * @param  q the queue to do the operation on
- * @return   the remaining cpu time of the tail of the queue
+ * Stores a workload in the cache, replacing any workload cached under the same name
+ * @param name name of the workload
+ * @param w    the workload (its reference goes to the cache)
  */
-int get_tail_remaining_time(GQueue * q) {
-  Process * proc = (Process *) g_queue_peek_tail(q);
-  return proc->remaining;
+void workload_store(const char * name, Workload * w) {
+  Workload * old;
+
+  g_mutex_lock(&workloads_lock);
+  old = g_hash_table_lookup(workloads, name);
+  g_hash_table_insert(workloads, g_strdup(name), w); //the cache keeps the key it was first stored with
+  g_mutex_unlock(&workloads_lock);
+  if(old != NULL && old != w) workload_unref(old);
 }
 
 /**
- * Get the remaining cpu time of the head of the queue
- * @param  q the queue to do the operation on
- * @return   the remaining cpu time of the head of the queue
+ * Removes a workload from the cache
+ * @param  name name of the workload
+ * @return      TRUE if the workload was cached
  */
-int get_head_remaining_time(GQueue * q) {
-  Process * proc = (Process *) g_queue_peek_head(q);
-  return proc->remaining;
+gboolean workload_drop(const char * name) {
+  Workload * w;
+
+  g_mutex_lock(&workloads_lock);
+  w = g_hash_table_lookup(workloads, name);
+  if(w != NULL) g_hash_table_remove(workloads, name);
+  g_mutex_unlock(&workloads_lock);
+  if(w != NULL) workload_unref(w);
+  return w != NULL;
 }
 
 /**
- * Get the Round Robin frequency for the head of the queue
- * @param  q the queue
- * @return   the Round Robin frequency for the head of the queue
+ * Reads a workload sent by a client, either as lines of text input data or as binary records
+ * of RECORD_FIELDS native 32 bit integers each
+ * @param  in     the connection
+ * @param  count  number of processes
+ * @param  binary TRUE for binary records, FALSE for text lines
+ * @return        the workload, NULL if the data is invalid or incomplete
  */
-int get_head_rr_freq(GQueue * q) {
-  Process * proc = (Process *) g_queue_peek_head(q);
-  return proc->rr;
+Workload * read_workload(FILE * in, int count, gboolean binary) {
+  Workload * w = malloc(sizeof(Workload));
+  GHashTable * templates = g_hash_table_new(g_direct_hash, g_direct_equal);
+  char line[MAX_LINE];
+  gint32 raw[RECORD_FIELDS];
+  int v[RECORD_FIELDS], i, j, fields;
+  Process * p;
+
+  assert(w != NULL);
+  w->procs = g_array_sized_new(FALSE, FALSE, sizeof(Process), MIN(count, LOAD_RESERVE)); //the count is the client's word
+  w->refs = 1;
+  for(i = 0; i < count; i++) {
+    if(binary) {
+      if(fread(raw, sizeof(gint32), RECORD_FIELDS, in) != RECORD_FIELDS) break;
+      for(j = 0; j < RECORD_FIELDS; j++) v[j] = raw[j];
+      p = process_from_record(v);
+    }
+    else {
+      p = NULL;
+      do fields = fgets(line, sizeof(line), in) != NULL ? parse_process(line, templates, &p) : 0;
+      while(fields == RECORD_TEMPLATE); //template lines come on top of the count
+      if(fields < 6) break;
+    }
+    g_array_append_val(w->procs, *p);
+    free(p);
+  }
+  g_hash_table_destroy(templates);
+  if(i < count) {
+    workload_unref(w);
+    return NULL;
+  }
+  return w;
 }
 
 /**
- * Get the Round Robin frequency for the head of the queue
- * @param  q the queue
- * @return   the Round Robin frequency for the head of the queue
+ * Creates a queue of processes from a workload, the same way parse_file() does from a file
+ * @param  w the workload
+ * @return   queue of processes
  */
-int get_tail_rr_freq(GQueue * q) {
-  Process * proc = (Process *) g_queue_peek_tail(q);
-  return proc->rr;
+GQueue * workload_queue(Workload * w) {
+  GQueue * queue = g_queue_new();
+  guint i;
+
+  for(i = 0; i < w->procs->len; i++) {
+    Process * p = malloc(sizeof(Process));
+    assert(p != NULL);
+    *p = g_array_index(w->procs, Process, i);
+    g_queue_push_head(queue, p);
+  }
+  return queue;
 }
 
 /**
- * Set the remaining time on the tail process of the queue
- * @param q   the queue
- * @param val the new remaining time value
+ * Gets the scheduling algorithm from its name
+ * @param  name fcfs, sjf, srtf, gang, rm or edf
+ * @return      the scheduling algorithm, -1 if unknown
  */
-void set_tail_remaining_time(GQueue * q, int val) {
-  Process * proc = (Process *) g_queue_peek_tail(q);
-  proc->remaining = val;
+int policy_from_name(const char * name) {
+  if(strcmp(name, "fcfs") == 0) return FCFS_SORT;
+  if(strcmp(name, "sjf") == 0) return SJF_SORT;
+  if(strcmp(name, "srtf") == 0) return SRTF_SORT;
+  if(strcmp(name, "gang") == 0) return GANG_SORT;
+  if(strcmp(name, "rm") == 0) return RM_SORT;
+  if(strcmp(name, "edf") == 0) return EDF_SORT;
+  return -1;
 }
 
 /**
- * Set the remaining time on the head process of the queue
- * @param q   the queue
- * @param val the new remaining time value
+ * Streams the metrics of a terminated process back to the client
+ * @param sim  the simulation
+ * @param p    the process
+ * @param data the connection
  */
-void set_head_last_start(GQueue * q, int val) {
-  Process * proc = (Process *) g_queue_peek_head(q);
-  proc->last_start = val;
+void send_process_metrics(Simulation * sim, Process * p, void * data) {
+  fprintf((FILE *) data, "PROC %d %d %d %d %d\n", p->pid, p->start, p->finish, p->finish - p->start, p->wait_time);
 }
 
 /**
- * Get the last start time of the head process of the queue
- * @param  q the queue to do the operation on
- * @return   the value of the last start
+ * Serves the commands of one client connection, on a worker thread. Commands:
+ *
+ *   LOAD <name> CSV <count>      followed by <count> lines of text input data (not counting
+ *                                template definitions)
+ *   LOAD <name> BINARY <count>   followed by <count> binary records
+ *   RUN <name> <policy>          simulates a cached workload with fcfs, sjf, srtf, gang, rm or edf
+ *   DROP <name>                  removes a workload from the cache
+ *   QUIT
+ *
+ * LOAD and DROP answer "OK <count>" or "ERROR <reason>", a LOAD of more than MAX_LOAD_PROCESSES
+ * processes being refused. RUN streams a
+ * "PROC <pid> <arrival> <finish> <turnaround> <wait>" line per process as it terminates, then
+ * "DONE <processes> <makespan> <dispatches> <context switches> <migrations> <idle cpu time>".
+ * @param data the connection's socket
+ * @param user unused
  */
-int get_head_last_start(GQueue * q) {
-  Process * proc = (Process *) g_queue_peek_head(q);
-  return proc->last_start;
+void handle_connection(gpointer data, gpointer user) {
+  int fd = GPOINTER_TO_INT(data);
+  FILE * in = fdopen(fd, "r");
+  FILE * out = fdopen(dup(fd), "w");
+  char line[MAX_LINE], cmd[16], name[MAX_NAME], arg[16];
+  int count, fields, sort, processes;
+  Workload * w;
+  Simulation * sim;
+
+  assert(in != NULL && out != NULL);
+  while(fgets(line, sizeof(line), in) != NULL) {
+    fields = sscanf(line, "%15s %63s %15s %d", cmd, name, arg, &count);
+    if(fields < 1) continue;
+
+    if(strcmp(cmd, "QUIT") == 0) break;
+    else if(strcmp(cmd, "LOAD") == 0 && fields == 4 && count >= 0
+        && (strcmp(arg, "CSV") == 0 || strcmp(arg, "BINARY") == 0)) {
+      if(count > MAX_LOAD_PROCESSES) {
+        fprintf(out, "ERROR workload too large\n");
+        break; //its records would be read as commands
+      }
+      w = read_workload(in, count, strcmp(arg, "BINARY") == 0);
+      if(w == NULL) {
+        fprintf(out, "ERROR invalid workload\n");
+        break; //the rest of the stream can not be trusted
+      }
+      workload_store(name, w);
+      fprintf(out, "OK %d\n", count);
+    }
+    else if(strcmp(cmd, "RUN") == 0 && fields >= 3) {
+      sort = policy_from_name(arg);
+      w = workload_lookup(name);
+      if(sort < 0) fprintf(out, "ERROR unknown policy %s\n", arg);
+      else if(w == NULL) fprintf(out, "ERROR unknown workload %s\n", name);
+      else {
+        sim = simulation_new(topology, workload_queue(w), sort, NULL);
+        processes = g_queue_get_length(sim->all);
+        sim->on_terminate = send_process_metrics;
+        sim->data = out;
+        simulation_run(sim);
+        fprintf(out, "DONE %d %d %lld %lld %lld %lld\n", processes, sim->stats.end_time, sim->stats.dispatches,
+          sim->stats.context_switches, sim->stats.migrations, sim->stats.idle_time);
+        simulation_free(sim);
+      }
+      if(w != NULL) workload_unref(w);
+    }
+    else if(strcmp(cmd, "DROP") == 0 && fields >= 2) {
+      if(workload_drop(name)) fprintf(out, "OK 0\n");
+      else fprintf(out, "ERROR unknown workload %s\n", name);
+    }
+    else fprintf(out, "ERROR unknown command\n");
+    fflush(out);
+  }
+  fclose(out);
+  fclose(in);
 }
 
 /**
- * Get the last start time of the tail process of the queue
- * @param  q the queue to do the operation on
- * @return   the value of the last start
+ * Runs the simulation server: accepts clients on a Unix domain socket and serves each
+ * connection on a pool of worker threads. Parsed workloads stay cached between connections.
+ * @param  path    path of the socket
+ * @param  workers number of worker threads
+ * @return         exit status (only returns on error)
  */
-int get_tail_last_start(GQueue * q) {
-  Process * proc = (Process *) g_queue_peek_tail(q);
-  return proc->last_start;
+int serve(const char * path, int workers) {
+  struct sockaddr_un addr;
+  GThreadPool * pool;
+  int listener, fd;
+
+  if(strlen(path) >= sizeof(addr.sun_path)) {
+    printf("Socket path too long\n");
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN); //a client going away must not take the server down
+  workloads = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+  g_mutex_init(&workloads_lock);
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path); //a socket left behind by a previous server
+  if(listener < 0 || bind(listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(listener, SERVER_BACKLOG) < 0) {
+    perror("Could not listen on socket");
+    return 1;
+  }
+
+  pool = g_thread_pool_new(handle_connection, NULL, MAX(workers, 1), TRUE, NULL);
+  printf("Simulation server listening on %s with %d workers\n", path, MAX(workers, 1));
+  while((fd = accept(listener, NULL, NULL)) >= 0 || errno == EINTR) {
+    if(fd >= 0) g_thread_pool_push(pool, GINT_TO_POINTER(fd), NULL);
+  }
+  perror("Could not accept connection");
+  g_thread_pool_free(pool, FALSE, TRUE);
+  close(listener);
+  return 1;
 }
 
 /**
- * Set the IO last start on the tail process of the queue
- * @param q   the queue
- * @param val the new IO last start time
+ * Sets up the simulator, must be called once before any other call
+ * @param topology_file topology of the simulated machine ("" or NULL for the compiled in default)
  */
-void set_tail_io_start(GQueue * q, int val) {
-  Process * proc = (Process *) g_queue_peek_tail(q);
-  proc->last_io_start = val;
+void scheduler_init(const char * topology_file) {
+  sjf_algorithm = &sort_sjf;
+  fcfs_algorithm = &sort_fcfs;
+  srtf_algorithm = &sort_srtf;
+  topology = load_topology(topology_file != NULL ? topology_file : "");
 }
 
 /**
- * Get the IO last start on the tail process of the queue
- * @param q   the queue
- * @param val the new IO last start time
+ * Gets the scheduling algorithm from its name
+ * @param  name fcfs, sjf, srtf, gang, rm or edf
+ * @return      the scheduling algorithm, -1 if unknown
  */
-int get_tail_last_io_start(GQueue * q) {
-  Process * proc = (Process *) g_queue_peek_tail(q);
-  return proc->last_io_start;
+int scheduler_policy(const char * name) {
+  return policy_from_name(name);
 }
 
-/*
- * Get the IO last start on the head process of the queue
- * @param q   the queue
- * @param val the new IO last start time
+/**
+ * Collects the metrics of a terminated process into the result being built
+ * @param sim  the simulation
+ * @param p    the process
+ * @param data array of ProcessMetrics
  */
-int get_head_last_io_start(GQueue * q) {
-  Process * proc = (Process *) g_queue_peek_head(q);
-  return proc->last_io_start;
+void collect_process_metrics(Simulation * sim, Process * p, void * data) {
+  ProcessMetrics m = { p->pid, p->start, p->finish, p->finish - p->start, p->wait_time };
+  g_array_append_val((GArray *) data, m);
 }
 
 /**
- * Moves a process from one state to another. The state transitions are determined by the 'move' paramater.
- * new/all --> ready; ready --> runninig; running --> terminated; running --> waiting; waiting --> ready; waiting --> ready; running --> ready.
- *
- * @param from
- * @param to
- * @param move
- * @param current_time
- * @param sort
+ * Simulates a workload. Only touches the simulation it creates, so it can be called from
+ * several threads at the same time.
+ * @param  records    the processes of the workload
+ * @param  count      number of records
+ * @param  policy     scheduling algorithm from scheduler_policy()
+ * @param  with_trace non-zero to also return the state transitions
+ * @return            the result, to be freed with scheduler_result_free()
  */
-void execute_move(GQueue * from, GQueue * to, int move, int current_time, int sort) {
-  const char * output_file;
-  gboolean must_sort = FALSE;
-
-  move_process(from, to);
+SchedulerResult * scheduler_run(const WorkloadRecord * records, int count, int policy, int with_trace) {
+  SchedulerResult * result = calloc(1, sizeof(SchedulerResult));
+  GQueue * all = g_queue_new();
+  GArray * metrics = g_array_sized_new(FALSE, FALSE, sizeof(ProcessMetrics), count);
+  Simulation * sim;
+  int i;
 
-  if(sort == FCFS_SORT) output_file = FCFS_OUTPUT;
-  else if(sort == SJF_SORT) output_file = SJF_OUTPUT;
-  else if(sort == SRTF_SORT) output_file = SRTF_OUTPUT;
+  assert(result != NULL);
+  for(i = 0; i < count; i++) {
+    int v[RECORD_FIELDS] = { records[i].pid, records[i].start, records[i].total, records[i].iofreq,
+      records[i].iodur, records[i].rr, records[i].node, records[i].mem, records[i].job };
+    g_queue_push_head(all, process_from_record(v)); //same order as parse_file()
+  }
 
-  switch(move) {
-    case NEW_TO_READY: // all --> ready
-      must_sort = TRUE;
-      write_update(output_file, current_time, get_tail_pid(to), NEW_STATE, READY_STATE);
-      break;
+  sim = simulation_new(topology, all, policy, NULL);
+  sim->on_terminate = collect_process_metrics;
+  sim->data = metrics;
+  if(with_trace) sim->events = g_array_new(FALSE, FALSE, sizeof(TraceEvent));
+  simulation_run(sim);
 
-    case READY_TO_RUNNING: // ready --> running
-      set_head_last_start(to, current_time);
-      write_update(output_file, current_time, get_tail_pid(to), READY_STATE, RUNNING_STATE);
-      break;
+  result->num_processes = metrics->len;
+  result->processes = (ProcessMetrics *) g_array_free(metrics, FALSE);
+  if(sim->events != NULL) {
+    result->num_events = sim->events->len;
+    result->events = (TraceEvent *) g_array_free(sim->events, FALSE);
+    sim->events = NULL;
+  }
+  result->makespan = sim->stats.end_time;
+  result->dispatches = sim->stats.dispatches;
+  result->context_switches = sim->stats.context_switches;
+  result->migrations = sim->stats.migrations;
+  result->idle_time = sim->stats.idle_time;
+  simulation_free(sim);
+  return result;
+}
 
-    case RUNNING_TO_TERMINATED: // running --> terminated
-      set_tail_remaining_time(to, 0);
-      write_update(output_file, current_time, get_tail_pid(to), RUNNING_STATE, TERMINATED_STATE);
-      break;
+/**
+ * Frees a simulation result and its buffers
+ * @param result the result
+ */
+void scheduler_result_free(SchedulerResult * result) {
+  if(result == NULL) return;
+  g_free(result->processes);
+  g_free(result->events);
+  free(result);
+}
 
-    case RUNNING_TO_WAITING: // running --> waiting
-      set_tail_remaining_time(to, get_tail_remaining_time(to)-get_tail_iofreq_val(to));
-      set_tail_io_start(to, current_time);
-      write_update(output_file, current_time, get_tail_pid(to), RUNNING_STATE, WAITING_STATE);
-      break;
+/**
+ * Runs the approximation mode: estimates how a workload fares under a scheduling algorithm, and
+ * for workloads of up to APPROX_CHECK_PROCESSES (not scaled up) checks the estimates against the
+ * exact engine
+ * @param  policy    fcfs, sjf, srtf, gang, rm or edf
+ * @param  filename  text input data of the workload
+ * @param  processes number of processes to scale the workload up to (0 to keep its size)
+ * @return           exit status
+ */
+int approx(const char * policy, const char * filename, gint64 processes) {
+  int sort = policy_from_name(policy);
+  struct workload_summary * s;
+  struct approximation estimate, exact;
+  Simulation * sim;
+  gint64 start;
 
-    case WAITING_TO_READY: // waiting --> ready
-      must_sort = TRUE;
-      write_update(output_file, current_time, get_tail_pid(to), WAITING_STATE, READY_STATE);
-      break;
+  if(sort < 0) {
+    printf("Unknown policy %s\n", policy);
+    return 1;
+  }
+  start = g_get_monotonic_time();
+  if((s = summarize_file(filename)) == NULL) {
+    printf("No such file\n");
+    return 1;
+  }
+  if(processes <= 0) processes = s->count;
+  printf("%s: %lld processes summarized in %.3f ms\n", filename, (long long) s->count,
+    (g_get_monotonic_time() - start) / 1000.0);
 
-    case RUNNING_TO_READY: // running --> ready
-      must_sort = TRUE;
-      set_tail_remaining_time(to, get_tail_remaining_time(to)-get_tail_rr_freq(to));
-      write_update(output_file, current_time, get_tail_pid(to), RUNNING_STATE, READY_STATE);
-      break;
+  start = g_get_monotonic_time();
+  estimate = approximate(s, sort, topology->num_cpus, processes);
+  print_approximation(policy, "approximation", estimate, g_get_monotonic_time() - start);
 
-    default:
-      return;
-      break;
+  if(processes == s->count && s->count <= APPROX_CHECK_PROCESSES) {
+    start = g_get_monotonic_time();
+    sim = simulation_new(topology, parse_file(filename, NULL, NULL, NULL), sort, NULL);
+    simulation_run(sim);
+    exact = simulation_measure(sim);
+    print_approximation(policy, "exact", exact, g_get_monotonic_time() - start);
+    printf("%s error: turnaround %+.1f%%, wait %+.1f%%, makespan %+.1f%%, utilization %+.1f%%\n", policy,
+      approx_error(estimate.turnaround, exact.turnaround), approx_error(estimate.wait, exact.wait),
+      approx_error(estimate.makespan, exact.makespan), approx_error(estimate.utilization, exact.utilization));
+    simulation_free(sim);
   }
+  free(s);
+  return 0;
+}
 
-  if(must_sort) {
-    if(sort == SJF_SORT) g_queue_sort(to, sjf_algorithm, NULL);
-    else if(sort == SRTF_SORT) g_queue_sort(to, srtf_algorithm, NULL);
+/**
+ * Simulates a segment of a sampled workload, on a copy of its processes
+ * @param seg  the segment
+ * @param sort the scheduling algorithm
+ * @return     the simulation, to be run with shard_run()
+ */
+struct shard sample_segment_start(struct sample_segment * seg, int sort) {
+  GQueue * q = g_queue_new();
+  struct shard s;
+  GList * l;
+  guint i;
+
+  for(l = seg->head, i = 0; i < seg->count; l = l->next, i++) {
+    Process * p = malloc(sizeof(Process));
+    assert(p != NULL);
+    *p = *(Process *) l->data;
+    g_queue_push_tail(q, p);
   }
+  s.start = ((Process *) seg->head->data)->start;
+  s.sim = simulation_new(topology, q, sort, NULL);
+  return s;
 }
 
 /**
- * Determines which transitions to make and calls the execute_move() method
- * @param  all
- * @param  ready
- * @param  running
- * @param  waiting
- * @param  terminated
- * @param  current_time
- * @param  sort
- * @return
+ * Collects the results of a simulated segment and frees its simulation
+ * @param seg the segment
+ * @param s   its simulation, run to the end
  */
-int get_next_move(GQueue * all, GQueue * ready, GQueue * running, GQueue * waiting, GQueue * terminated, int current_time, int sort) {
-  assert(current_time >= 0);
-  int move = INVALID_MOVE;
-  int all_to_ready = INT_MAX, ready_to_running = INT_MAX,running_to_terminated = INT_MAX,
-    running_to_waiting = INT_MAX, waiting_to_ready = INT_MAX, running_to_ready = INT_MAX;
+void sample_segment_finish(struct sample_segment * seg, struct shard * s) {
+  GList * l;
 
-  GQueue * from;
-  GQueue * to;
+  for(l = s->sim->terminated->head; l != NULL; l = l->next) {
+    Process * p = l->data;
+    seg->terminated++;
+    seg->turnaround += p->finish - p->start;
+    seg->wait += p->wait_time;
+  }
+  seg->end = s->sim->stats.end_time;
+  simulation_free(s->sim);
+}
 
-  /*-----
-   The next move is determined based on the SOONEST of any of these times:
-            - ArrivalTime of processes in the new state OR
-            - I/O time of currently running process OR
-            - End time of a process' I/O operation OR
-            - Remaining time left for the process to complete execution
-            - Next I/O time for the currently running process
-   --------*/
-  if(!g_queue_is_empty(all)) all_to_ready = get_head_start_val(all);
-  if(!g_queue_is_empty(ready) && g_queue_is_empty(running)) ready_to_running = MAX(current_time,get_head_start_val(ready));
-  if(!g_queue_is_empty(running)) running_to_waiting = get_next_io_time(running, current_time);
-  if(!g_queue_is_empty(running)) running_to_terminated = get_head_remaining_time(running) + get_head_last_start(running);
-  if(!g_queue_is_empty(waiting)) waiting_to_ready = get_head_last_io_start(waiting) + get_head_iodur(waiting);
-  if(!g_queue_is_empty(running)) running_to_ready = get_head_last_start(running) + get_head_rr_freq(running);
+/**
+ * Estimates the mean turnaround or wait of the processes of a workload from its sampled segments
+ * (a ratio estimator: the segments are the sampling units, their processes what is averaged)
+ * @param  segs    the segments
+ * @param  order   indices of the segments in the order they are sampled
+ * @param  k       number of segments sampled so far
+ * @param  wait    TRUE for the wait, FALSE for the turnaround
+ * @param  half    set to the half width of the confidence interval of the estimate
+ * @return         the estimate
+ */
+double sample_estimate(GArray * segs, const guint * order, guint k, gboolean wait, double * half) {
+  double x = 0, y = 0, r, d, var = 0;
+  guint i;
 
-  //sanitize any addition overflows
-  all_to_ready = all_to_ready < 0 ? INT_MAX : all_to_ready;
-  ready_to_running = ready_to_running < 0 ? INT_MAX : ready_to_running;
-  running_to_waiting = running_to_waiting < 0 ? INT_MAX : running_to_waiting;
-  running_to_terminated = running_to_terminated < 0 ? INT_MAX : running_to_terminated;
-  waiting_to_ready = waiting_to_ready < 0 ? INT_MAX : waiting_to_ready;
-  running_to_ready = running_to_ready < 0 ? INT_MAX : running_to_ready;
+  for(i = 0; i < k; i++) {
+    struct sample_segment * seg = &g_array_index(segs, struct sample_segment, order[i]);
+    x += seg->terminated;
+    y += wait ? seg->wait : seg->turnaround;
+  }
+  r = x > 0 ? y / x : 0;
+  *half = 0;
+  if(k < 2 || x == 0) return r;
+  for(i = 0; i < k; i++) {
+    struct sample_segment * seg = &g_array_index(segs, struct sample_segment, order[i]);
+    d = (wait ? seg->wait : seg->turnaround) - r * seg->terminated;
+    var += d * d;
+  }
+  var = var / (k - 1) / k * (1 - (double) k / segs->len); //finite population: no error left once every segment is in
+  *half = SAMPLE_Z * sqrt(var) / (x / k);
+  return r;
+}
 
-  int min = MIN(MIN(MIN(MIN(MIN(all_to_ready, ready_to_running), running_to_terminated), running_to_waiting), waiting_to_ready), running_to_ready);
+/**
+ * Runs the sampled simulation: splits a workload into segments, simulates randomly chosen ones
+ * exactly, SHARD_WORKERS at a time, until the confidence intervals of the mean turnaround and
+ * wait are within a fraction of the estimates, and extrapolates. Segments are busy periods when
+ * those are independent (see busy_periods_independent()), which makes the sample unbiased;
+ * otherwise they are windows of consecutive arrivals, simulated from an empty machine, which
+ * underestimates the queueing of busy windows. The last segment is always simulated, it gives
+ * the makespan.
+ * @param  policy    fcfs, sjf, srtf, gang, rm or edf
+ * @param  filename  text input data of the workload
+ * @param  precision half width of the confidence intervals to stop at, relative to the estimates
+ * @return           exit status
+ */
+int sample(const char * policy, const char * filename, double precision) {
+  int sort = policy_from_name(policy);
+  struct sample_segment seg = { NULL, 0, 0, 0, 0, 0 }, last;
+  struct approximation estimate = { 0, 0, 0, 0 }, exact;
+  struct shard * batch;
+  double half_turnaround = 0, half_wait = 0, work = 0, simulated = 0;
+  gboolean busy_periods;
+  GThreadPool * pool;
+  GArray * segs, * sizes;
+  Simulation * sim;
+  GRand * rand;
+  gint64 start;
+  guint * order, i, j, k = 0, n;
+  GList * l;
 
-  if(min == INT_MAX) return move;
-  else if(min == waiting_to_ready) {
-    move = WAITING_TO_READY;
-    from = waiting;
-    to = ready;
+  if(sort < 0) {
+    printf("Unknown policy %s\n", policy);
+    return 1;
   }
-  else if(min == all_to_ready) {
-    move = NEW_TO_READY;
-    from = all;
-    to = ready;
+  sim = simulation_new(topology, parse_file(filename, NULL, NULL, NULL), sort, NULL); //sorts the processes by arrival
+  if(g_queue_is_empty(sim->all)) {
+    simulation_free(sim);
+    return 0;
   }
-
-  else if(min == running_to_ready) {
-    move = RUNNING_TO_READY;
-    from = running;
-    to = ready;
+  start = g_get_monotonic_time();
+  busy_periods = busy_periods_independent(sim);
+  sizes = busy_periods ? shard_sizes(sim->all, SAMPLE_MIN_PROCESSES) : g_array_new(FALSE, FALSE, sizeof(guint));
+  if(sizes->len < 2) { //no idle gaps to split at: windows of consecutive arrivals
+    busy_periods = FALSE;
+    g_array_set_size(sizes, 0);
+    for(n = g_queue_get_length(sim->all); n > 0; n -= seg.count) {
+      seg.count = MIN(n, SAMPLE_MIN_PROCESSES);
+      g_array_append_val(sizes, seg.count);
+    }
   }
-  else if(min == running_to_waiting) {
-    move = RUNNING_TO_WAITING;
-    from = running;
-    to = waiting;
+  segs = g_array_sized_new(FALSE, FALSE, sizeof(struct sample_segment), sizes->len);
+  for(l = sim->all->head, i = 0; i < sizes->len; i++) {
+    seg.head = l;
+    seg.count = g_array_index(sizes, guint, i);
+    for(j = 0; j < seg.count; j++, l = l->next) work += ((Process *) l->data)->tmpl->total;
+    g_array_append_val(segs, seg);
   }
-  else if(min == running_to_terminated) {
-    move = RUNNING_TO_TERMINATED;
-    from = running;
-    to = terminated;
+  n = segs->len;
+  g_array_free(sizes, TRUE);
+
+  //random order of the segments (Fisher-Yates)
+  order = malloc(n * sizeof(guint));
+  assert(order != NULL);
+  rand = g_rand_new_with_seed(SAMPLE_SEED);
+  for(i = 0; i < n; i++) order[i] = i;
+  for(i = n - 1; i > 0; i--) {
+    j = g_rand_int_range(rand, 0, i + 1);
+    k = order[i];
+    order[i] = order[j];
+    order[j] = k;
   }
-  else if(min == ready_to_running) {
-    move = READY_TO_RUNNING;
-    from = ready;
-    to = running;
+  g_rand_free(rand);
+
+  last = g_array_index(segs, struct sample_segment, n - 1);
+  batch = calloc(SHARD_WORKERS + 1, sizeof(struct shard));
+  assert(batch != NULL);
+  for(k = 0; k < n;) {
+    pool = g_thread_pool_new(shard_run, NULL, SHARD_WORKERS, TRUE, NULL);
+    for(i = 0; i < SHARD_WORKERS && k + i < n; i++) {
+      batch[i] = sample_segment_start(&g_array_index(segs, struct sample_segment, order[k + i]), sort);
+      g_thread_pool_push(pool, &batch[i], NULL);
+    }
+    if(k == 0) { //the last segment, for the makespan
+      batch[SHARD_WORKERS] = sample_segment_start(&last, sort);
+      g_thread_pool_push(pool, &batch[SHARD_WORKERS], NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+    if(k == 0) sample_segment_finish(&last, &batch[SHARD_WORKERS]);
+    for(j = 0; j < i; j++) {
+      sample_segment_finish(&g_array_index(segs, struct sample_segment, order[k + j]), &batch[j]);
+      simulated += g_array_index(segs, struct sample_segment, order[k + j]).count;
+    }
+    k += i;
+    estimate.turnaround = sample_estimate(segs, order, k, FALSE, &half_turnaround);
+    estimate.wait = sample_estimate(segs, order, k, TRUE, &half_wait);
+    if(k >= SAMPLE_MIN_SEGMENTS && half_turnaround <= precision * estimate.turnaround
+      && half_wait <= precision * estimate.wait) break;
   }
-  else return move;
-  /*--------------------------------------------------*/
-  //ready to running is being checked before waiting to ready and that is wrong!
+  //a window misses the backlog it inherits, the cpus can not do the work any faster than this though
+  estimate.makespan = MAX(last.end - ((Process *) g_queue_peek_head(sim->all))->start, work / sim->num_cpus);
+  estimate.utilization = estimate.makespan > 0 ? work / (sim->num_cpus * estimate.makespan) : 0;
+  printf("%s sample: %u of %u %s (%.1f%% of the processes) simulated in %.3f ms\n", policy, k, n,
+    busy_periods ? "busy periods" : "windows", 100 * simulated / g_queue_get_length(sim->all),
+    (g_get_monotonic_time() - start) / 1000.0);
+  printf("%s estimate: turnaround %.1f +- %.1f, wait %.1f +- %.1f, makespan %.0f, utilization %.3f\n", policy,
+    estimate.turnaround, half_turnaround, estimate.wait, half_wait, estimate.makespan, estimate.utilization);
+  if(!busy_periods) printf("%s windows start from an empty machine, the estimates are low while work queues up\n", policy);
+  free(batch);
+  free(order);
+  g_array_free(segs, TRUE);
 
-  current_time = min;
-  execute_move(from, to, move, current_time, sort); //execute the move
-  return current_time;
+  if(g_queue_get_length(sim->all) <= APPROX_CHECK_PROCESSES) {
+    start = g_get_monotonic_time();
+    simulation_run(sim);
+    exact = simulation_measure(sim);
+    print_approximation(policy, "exact", exact, g_get_monotonic_time() - start);
+    printf("%s error: turnaround %+.1f%%, wait %+.1f%%, makespan %+.1f%%, utilization %+.1f%%\n", policy,
+      approx_error(estimate.turnaround, exact.turnaround), approx_error(estimate.wait, exact.wait),
+      approx_error(estimate.makespan, exact.makespan), approx_error(estimate.utilization, exact.utilization));
+  }
+  simulation_free(sim);
+  return 0;
 }
 
 /**
- * Reallocate all the processes from these queues to the system
- *
- * @param all        the all/new queue
- * @param ready      the ready queue
- * @param running    the running queue
- * @param waiting    the waiting
- * @param terminated the terminated queue
+ * Writes the summary record of a process that terminated in a streamed run, before its slot
+ * is reused
+ * @param sim  the simulation
+ * @param p    the process
+ * @param data the stream_totals of the run
  */
-void realloc_q_procs(GQueue * all, GQueue * ready, GQueue * running, GQueue * waiting, GQueue * terminated) {
-  while(!g_queue_is_empty(all)) {
-    free(g_queue_pop_head(all));
-  }
-  while(!g_queue_is_empty(ready)) {
-    free(g_queue_pop_head(ready));
+void stream_process(Simulation * sim, Process * p, void * data) {
+  struct stream_totals * totals = data;
+
+  send_process_metrics(sim, p, totals->file);
+  totals->count++;
+  totals->turnaround += p->finish - p->start;
+  totals->wait += p->wait_time;
+}
+
+/**
+ * Runs a streamed simulation: reads the workload as the simulation reaches its arrivals, writes
+ * the "PROC <pid> <arrival> <finish> <turnaround> <wait>" summary of every process as it
+ * terminates and reuses its memory for the next arrivals, so that memory follows the number of
+ * processes in the system rather than the size of the workload. The input must be in order of
+ * arrival.
+ * @param  policy   fcfs, sjf or srtf
+ * @param  filename text input data of the workload
+ * @param  output   file the summaries are written to
+ * @return          exit status
+ */
+int stream(const char * policy, const char * filename, const char * output) {
+  int sort = policy_from_name(policy);
+  struct stream_totals totals = { NULL, 0, 0, 0 };
+  Simulation * sim;
+  gboolean failed;
+  gint64 start;
+  FILE * fp;
+
+  if(sort < 0) {
+    printf("Unknown policy %s\n", policy);
+    return 1;
   }
-  while(!g_queue_is_empty(running)) {
-    free(g_queue_pop_head(running));
+  if(sort == GANG_SORT) { //gangs are set up from every member of the workload
+    printf("Gang scheduling can not be streamed\n");
+    return 1;
   }
-  while(!g_queue_is_empty(waiting)) {
-    free(g_queue_pop_head(waiting));
+  if((fp = fopen(filename, "r")) == NULL) {
+    printf("No such file\n");
+    return 1;
   }
-  while(!g_queue_is_empty(terminated)) {
-    free(g_queue_pop_head(terminated));
+  if((totals.file = fopen(output, "w")) == NULL) {
+    printf("Can not write %s\n", output);
+    fclose(fp);
+    return 1;
   }
+  sim = simulation_new(topology, g_queue_new(), sort, NULL);
+  source_open(sim, fp);
+  sim->on_terminate = stream_process;
+  sim->data = &totals;
+
+  start = g_get_monotonic_time();
+  simulation_run(sim);
+  failed = sim->source->failed; //the run stopped at the first process that could not be read
+  if(failed) printf("Error reading! Invalid format, or not in order of arrival!\n");
+  else printf("Finished processing %s\n", filename);
+  print_overhead_stats(sim, policy);
+  printf("%s stream: %llu processes in %.0f ms, at most %u in memory (%llu bytes)\n", policy,
+    (unsigned long long) totals.count, (g_get_monotonic_time() - start) / 1000.0, sim->slots,
+    (unsigned long long) sim->slots * sizeof(Process));
+  printf("%s mean turnaround %.1f, wait %.1f, summaries written to: %s\n", policy,
+    totals.count > 0 ? totals.turnaround / totals.count : 0.0, totals.count > 0 ? totals.wait / totals.count : 0.0, output);
+  fclose(totals.file);
+  simulation_free(sim);
+  return failed ? 1 : 0;
 }
 
 /**
- * Reallocate all the q to the system by freeing all processes in the queues
- * and then by freeing the queues themselves
+ * Simulates a workload with one scheduling algorithm, including the dependencies of its D lines,
+ * the locks of its L and C lines and the periodic tasks of its R lines
+ * @param  policy   fcfs, sjf, srtf, gang, rm or edf
+ * @param  filename text input data of the workload
+ * @param  output   file the trace is appended to
+ * @param  horizon  periodic tasks release no job at or after it (0 for none, then R lines are
+ *                  an error)
+ * @return          exit status
  */
-void realloc_q(GQueue * all, GQueue * ready, GQueue * running, GQueue * waiting, GQueue * terminated) {
-  realloc_q_procs(all, ready, running, waiting, terminated);
-  g_queue_free(all);
-  g_queue_free(ready);
-  g_queue_free(running);
-  g_queue_free(waiting);
-  g_queue_free(terminated);
+int run(const char * policy, const char * filename, const char * output, int horizon) {
+  const char * titles[] = { FCFS_TITLE, SJF_TITLE, SRTF_TITLE, GANG_TITLE, RM_TITLE, EDF_TITLE }; //by sorting algorithm
+  int sort = policy_from_name(policy);
+  struct lock_spec locks;
+  GArray * edges, * tasks;
+  Simulation * sim;
+
+  if(sort < 0) {
+    printf("Unknown policy %s\n", policy);
+    return 1;
+  }
+  edges = g_array_new(FALSE, FALSE, sizeof(struct dependency));
+  locks.units = g_array_new(FALSE, FALSE, sizeof(struct lock_units));
+  locks.sections = g_array_new(FALSE, FALSE, sizeof(struct critical_section));
+  tasks = g_array_new(FALSE, FALSE, sizeof(struct periodic_task));
+  sim = simulation_new(topology, parse_file(filename, edges, &locks, tasks), sort, NULL);
+  //jobs reuse the slots of the jobs before them, which the dependencies and lock scripts of a process would outlive
+  if(tasks->len > 0 && (horizon <= 0 || edges->len > 0 || locks.sections->len > 0)) {
+    printf(horizon <= 0 ? "Periodic tasks need a horizon\n" : "Periodic tasks can not have dependencies or locks\n");
+    g_array_free(edges, TRUE);
+    g_array_free(locks.units, TRUE);
+    g_array_free(locks.sections, TRUE);
+    g_array_free(tasks, TRUE);
+    simulation_free(sim);
+    return 1;
+  }
+  if(edges->len > 0) setup_dependencies(sim, edges);
+  if(locks.sections->len > 0) setup_locks(sim, &locks);
+  if(tasks->len > 0) setup_periodic(sim, tasks, horizon);
+  g_array_free(edges, TRUE);
+  g_array_free(locks.units, TRUE);
+  g_array_free(locks.sections, TRUE);
+  g_array_free(tasks, TRUE);
+  open_trace(sim, output, titles[sort]);
+  simulation_run(sim);
+  print_overhead_stats(sim, policy);
+  printf("%s simulation trace written to: %s%s\n", policy, output, TRACE_COMPRESS ? ".gz" : "");
+  simulation_free(sim);
+  return 0;
 }
 
+#ifndef SCHEDULER_NO_MAIN
 /**
  * The main method is the driver for the different input files. Here we have specified
- * three different default files for testing FCFS algorithm, SJF algorithm and SRTF algorithm
+ * different default files for testing FCFS algorithm, SJF algorithm, SRTF algorithm and Gang Scheduling.
+ * Run as "scheduler serve <socket path> [workers]" it becomes a simulation server instead, and
+ * "scheduler check <replay log> <replay log>" compares the replay logs of two runs,
+ * "scheduler run <policy> <input> <trace> [horizon]" simulates any input, with its dependencies, locks
+ * and periodic tasks (released until the horizon),
+ * "scheduler approx <policy> <input> [processes]" estimates a run instead of simulating it,
+ * "scheduler sample <policy> <input> [precision]" simulates a random sample of it, and
+ * "scheduler stream <policy> <input> <summaries>" simulates it in memory bounded by concurrency.
  * @return [description]
  */
-int main() {
-  int t = INITIAL_TIME;
+int main(int argc, char ** argv) {
+  Simulation * sim;
+  Topology * gang_topology;
   /**/
-  sjf_algorithm = &sort_sjf;
-  fcfs_algorithm = &sort_fcfs;
-  srtf_algorithm = &sort_srtf;
+  scheduler_init(TOPOLOGY_FILE);
 
-  GQueue * all;
-  //Queues below named after the different states of the processes
-  GQueue * ready = g_queue_new();
-  GQueue * running = g_queue_new();
-  GQueue * waiting = g_queue_new();
-  GQueue * terminated = g_queue_new();
+  if(argc >= 3 && strcmp(argv[1], "serve") == 0) {
+    return serve(argv[2], argc >= 4 ? atoi(argv[3]) : SERVER_WORKERS);
+  }
+  if(argc >= 4 && strcmp(argv[1], "check") == 0) {
+    return replay_check(argv[2], argv[3]);
+  }
+  if(argc >= 4 && strcmp(argv[1], "approx") == 0) {
+    return approx(argv[2], argv[3], argc >= 5 ? strtoll(argv[4], NULL, 10) : 0);
+  }
+  if(argc >= 5 && strcmp(argv[1], "run") == 0) {
+    return run(argv[2], argv[3], argv[4], argc >= 6 ? atoi(argv[5]) : 0);
+  }
+  if(argc >= 5 && strcmp(argv[1], "stream") == 0) {
+    return stream(argv[2], argv[3], argv[4]);
+  }
+  if(argc >= 4 && strcmp(argv[1], "sample") == 0) {
+    return sample(argv[2], argv[3], argc >= 5 ? atof(argv[4]) : SAMPLE_PRECISION);
+  }
 
   // First Come First Serve
-  write_to_file(FCFS_OUTPUT, "--- FIRST COME FIRST SERVE SCHEDULING SIMULATION ---\n");
-  write_to_file(FCFS_OUTPUT, "time\tpid\told state\tnew state\n");
-
-  all = parse_file(FCFS_INPUT); //populates the 'all' queue with the text Ginput data
-  g_queue_sort(all, fcfs_algorithm, NULL);
-  while((t = get_next_move(all, ready, running, waiting, terminated, t, FCFS_SORT)) != INVALID_MOVE); //
-  printf("FCFS simulation trace written to: %s\n\n", FCFS_OUTPUT);
+  sim = simulation_new(topology, parse_file(FCFS_INPUT, NULL, NULL, NULL), FCFS_SORT, NULL); //populates the 'all' queue with the text Ginput data
+  open_trace(sim, FCFS_OUTPUT, FCFS_TITLE);
+  if(REPLAY_LOG) sim->replay = replay_open(FCFS_REPLAY);
+  if(METRICS_WINDOW > 0) sim->metrics = metrics_open(FCFS_METRICS, METRICS_WINDOW);
+  simulation_run(sim);
+  print_overhead_stats(sim, "FCFS");
+  printf("FCFS simulation trace written to: %s%s\n\n", FCFS_OUTPUT, TRACE_COMPRESS ? ".gz" : "");
   //reset
-  realloc_q_procs(all, ready, running, waiting, terminated);
-  t = INITIAL_TIME;
+  simulation_free(sim);
 
   // Shortest Job First
-  write_to_file(SJF_OUTPUT, "--- SHORTEST JOB FIRST SCHEDULING SIMULATION ---\n");
-  write_to_file(SJF_OUTPUT, "time\tpid\told state\tnew state\n");
-
-  all = parse_file(SJF_INPUT);
-  g_queue_sort(all, fcfs_algorithm, NULL); //sort in earliest first always
-  while((t = get_next_move(all, ready, running, waiting, terminated, t, SJF_SORT)) != INVALID_MOVE);
-  printf("SJF simulation trace written to: %s\n\n", SJF_OUTPUT);
+  sim = simulation_new(topology, parse_file(SJF_INPUT, NULL, NULL, NULL), SJF_SORT, NULL);
+  open_trace(sim, SJF_OUTPUT, SJF_TITLE);
+  if(REPLAY_LOG) sim->replay = replay_open(SJF_REPLAY);
+  if(METRICS_WINDOW > 0) sim->metrics = metrics_open(SJF_METRICS, METRICS_WINDOW);
+  simulation_run(sim);
+  print_overhead_stats(sim, "SJF");
+  printf("SJF simulation trace written to: %s%s\n\n", SJF_OUTPUT, TRACE_COMPRESS ? ".gz" : "");
   //reset
-  realloc_q_procs(all, ready, running, waiting, terminated);
-  t = INITIAL_TIME;
+  simulation_free(sim);
 
   // Shortest Remaining Time First
-  write_to_file(SRTF_OUTPUT, "--- SHORTEST REMAINING TIME FIRST SCHEDULING SIMULATION ---\n");
-  write_to_file(SRTF_OUTPUT, "time\tpid\told state\tnew state\n");
+  sim = simulation_new(topology, parse_file(SRTF_INPUT, NULL, NULL, NULL), SRTF_SORT, NULL);
+  open_trace(sim, SRTF_OUTPUT, SRTF_TITLE);
+  if(REPLAY_LOG) sim->replay = replay_open(SRTF_REPLAY);
+  if(METRICS_WINDOW > 0) sim->metrics = metrics_open(SRTF_METRICS, METRICS_WINDOW);
+  simulation_run(sim);
+  print_overhead_stats(sim, "SRTF");
+  printf("SRTF simulation trace written to: %s%s\n\n", SRTF_OUTPUT, TRACE_COMPRESS ? ".gz" : "");
+  //reset
+  simulation_free(sim);
 
-  all = parse_file(SRTF_INPUT);
-  g_queue_sort(all, fcfs_algorithm, NULL); //sort in earliest first always
-  while((t = get_next_move(all, ready, running, waiting, terminated, t, SRTF_SORT)) != INVALID_MOVE);
-  printf("SRTF simulation trace written to: %s\n", SRTF_OUTPUT);
+  // Gang Scheduling
+  //a topology file given by the user wins over the machine of the sample
+  gang_topology = strlen(TOPOLOGY_FILE) == 0 && strlen(GANG_TOPOLOGY) > 0 ? load_topology(GANG_TOPOLOGY) : topology;
+  sim = simulation_new(gang_topology, parse_file(GANG_INPUT, NULL, NULL, NULL), GANG_SORT, NULL);
+  open_trace(sim, GANG_OUTPUT, GANG_TITLE);
+  if(REPLAY_LOG) sim->replay = replay_open(GANG_REPLAY);
+  if(METRICS_WINDOW > 0) sim->metrics = metrics_open(GANG_METRICS, METRICS_WINDOW);
+  simulation_run(sim);
+  print_overhead_stats(sim, "GANG");
+  printf("GANG simulation trace written to: %s%s\n", GANG_OUTPUT, TRACE_COMPRESS ? ".gz" : "");
 
-  realloc_q(all, ready, running, waiting, terminated);
+  simulation_free(sim);
+  if(gang_topology != topology) topology_free(gang_topology);
   return 0;
 }
+#endif
 
 // Created by Ryan Seys and Osazuwa Omigie
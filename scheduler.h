@@ -0,0 +1,123 @@
+/**
+ * Scheduling Simulation library interface
+ *
+ * Authors: Ryan Seys and Osazuwa Omigie
+ *
+ * Build libscheduler.so with "make lib". Every call to scheduler_run() works on its own
+ * simulation, so several workloads can be simulated at the same time from different threads.
+ * The buffers of a result are allocated by the simulator and stay valid until the result is
+ * freed with scheduler_result_free(), so callers can use them in place instead of copying.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/**
+ * Workload record, the columns of the input file format in order
+ *
+ * pid, start, total, iofreq, iodur, rr: the required columns
+ * node, mem, job: the optional columns (-1, 0 and -1 when unused)
+ */
+struct workload_record {
+    int pid;
+    int start;
+    int total;
+    int iofreq;
+    int iodur;
+    int rr;
+    int node;
+    int mem;
+    int job;
+};
+
+typedef struct workload_record WorkloadRecord;
+
+/**
+ * Metrics of a process once it terminated
+ *
+ * pid: process id
+ * arrival: start time from the workload
+ * finish: time the process terminated
+ * turnaround: finish - arrival
+ * wait: time spent in the ready queue
+ */
+struct process_metrics {
+    int pid;
+    int arrival;
+    int finish;
+    int turnaround;
+    int wait;
+};
+
+typedef struct process_metrics ProcessMetrics;
+
+/**
+ * A state transition of a process, the same as a line of the trace files
+ *
+ * time: time of the transition
+ * pid: process id
+ * old_state, new_state: state codes (READY 1, RUNNING 2, WAITING 3, TERMINATED 4, NEW 5, REJECTED 6,
+ *                       BLOCKED 7)
+ */
+struct trace_event {
+    int time;
+    int pid;
+    int old_state;
+    int new_state;
+};
+
+typedef struct trace_event TraceEvent;
+
+/**
+ * Result of a simulation
+ *
+ * num_processes, processes: metrics of every process, in order of termination
+ * num_events, events: state transitions (NULL unless a trace was asked for)
+ * makespan: time of the last transition
+ * dispatches, context_switches, migrations: overhead counts
+ * idle_time: cpu time left idle
+ */
+struct scheduler_result {
+    int num_processes;
+    ProcessMetrics * processes;
+    int num_events;
+    TraceEvent * events;
+    int makespan;
+    int dispatches;
+    int context_switches;
+    int migrations;
+    long long idle_time;
+};
+
+typedef struct scheduler_result SchedulerResult;
+
+/**
+ * Sets up the simulator, must be called once before any other call
+ * @param topology_file topology of the simulated machine ("" or NULL for the compiled in default)
+ */
+void scheduler_init(const char * topology_file);
+
+/**
+ * Gets the scheduling algorithm from its name
+ * @param  name fcfs, sjf, srtf, gang, rm or edf
+ * @return      the scheduling algorithm, -1 if unknown
+ */
+int scheduler_policy(const char * name);
+
+/**
+ * Simulates a workload
+ * @param  records    the processes of the workload
+ * @param  count      number of records
+ * @param  policy     scheduling algorithm from scheduler_policy()
+ * @param  with_trace non-zero to also return the state transitions
+ * @return            the result, to be freed with scheduler_result_free()
+ */
+SchedulerResult * scheduler_run(const WorkloadRecord * records, int count, int policy, int with_trace);
+
+/**
+ * Frees a simulation result and its buffers
+ * @param result the result
+ */
+void scheduler_result_free(SchedulerResult * result);
+
+#endif
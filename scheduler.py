@@ -0,0 +1,174 @@
+"""
+Python bindings for the Scheduling Simulation (libscheduler.so, build it with "make lib")
+
+Workloads are NumPy structured arrays with the WORKLOAD dtype, one record per process. The
+results are arrays over the buffers the simulator filled in, no copies are made; the buffers
+are freed when the last array using them goes away.
+
+    import scheduler
+    w = scheduler.load_csv("test_inputs/srtf.txt")
+    r = scheduler.simulate(w, "srtf", trace=True)
+    r.processes["turnaround"].mean()
+    results = scheduler.compare(w, ["fcfs", "sjf", "srtf"])
+
+The simulator does not hold the GIL while it runs, so compare() simulates the policies in
+parallel threads.
+"""
+
+import ctypes
+import os
+import weakref
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+WORKLOAD = np.dtype([("pid", np.int32), ("start", np.int32), ("total", np.int32),
+                     ("iofreq", np.int32), ("iodur", np.int32), ("rr", np.int32),
+                     ("node", np.int32), ("mem", np.int32), ("job", np.int32)])
+
+PROCESS_METRICS = np.dtype([("pid", np.int32), ("arrival", np.int32), ("finish", np.int32),
+                            ("turnaround", np.int32), ("wait", np.int32)])
+
+TRACE_EVENT = np.dtype([("time", np.int32), ("pid", np.int32),
+                        ("old_state", np.int32), ("new_state", np.int32)])
+
+# state codes used in TRACE_EVENT
+READY, RUNNING, WAITING, TERMINATED, NEW, REJECTED, BLOCKED = 1, 2, 3, 4, 5, 6, 7
+
+
+class _Result(ctypes.Structure):
+    _fields_ = [("num_processes", ctypes.c_int),
+                ("processes", ctypes.c_void_p),
+                ("num_events", ctypes.c_int),
+                ("events", ctypes.c_void_p),
+                ("makespan", ctypes.c_int),
+                ("dispatches", ctypes.c_int),
+                ("context_switches", ctypes.c_int),
+                ("migrations", ctypes.c_int),
+                ("idle_time", ctypes.c_longlong)]
+
+
+_lib = None
+
+
+def init(library=None, topology=""):
+    """Loads the simulator library and sets up the simulated machine from a topology file
+    ("" for the compiled in default). Called with the defaults on first use."""
+    global _lib
+    if _lib is not None:
+        return
+    if library is None:
+        library = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libscheduler.so")
+    lib = ctypes.CDLL(library)
+    lib.scheduler_init.argtypes = [ctypes.c_char_p]
+    lib.scheduler_init.restype = None
+    lib.scheduler_policy.argtypes = [ctypes.c_char_p]
+    lib.scheduler_policy.restype = ctypes.c_int
+    lib.scheduler_run.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.scheduler_run.restype = ctypes.POINTER(_Result)
+    lib.scheduler_result_free.argtypes = [ctypes.POINTER(_Result)]
+    lib.scheduler_result_free.restype = None
+    lib.scheduler_init(topology.encode())
+    _lib = lib
+
+
+def workload(records):
+    """Creates a workload from a sequence of (pid, start, total, iofreq, iodur, rr) tuples,
+    optionally followed by node, mem and job"""
+    w = np.zeros(len(records), dtype=WORKLOAD)
+    w["node"] = -1
+    w["job"] = -1
+    for i, r in enumerate(records):
+        for j, v in enumerate(r):
+            w[i][j] = v
+    return w
+
+
+# lines of the input file format a WORKLOAD array has no room for
+_UNSUPPORTED = {"P": "burst program templates", "D": "job dependencies", "L": "locks",
+                "C": "critical sections", "R": "periodic tasks"}
+
+
+def load_csv(filename):
+    """Reads a workload from a file in the input file format, expanding template lines.
+    Raises ValueError on burst program templates (P), dependencies (D), locks (L, C) and
+    periodic tasks (R), which the bindings can not simulate."""
+    records = []
+    templates = {}
+    with open(filename) as f:
+        for number, line in enumerate(f, 1):
+            kind, _, rest = line.partition(",")
+            if kind in _UNSUPPORTED:
+                raise ValueError("%s:%d: %s are not supported by the bindings"
+                                 % (filename, number, _UNSUPPORTED[kind]))
+            if kind == "T":
+                fields = [int(v) for v in rest.strip().split(",") if v != ""]
+                templates[fields[0]] = fields[1:5]
+                continue
+            if kind == "I":
+                fields = [int(v) for v in rest.strip().split(",") if v != ""]
+                if len(fields) < 3 or fields[0] not in templates:
+                    break
+                fields = fields[1:3] + templates[fields[0]] + fields[3:]
+            else:
+                fields = [int(v) for v in line.strip().split(",") if v != ""]
+            if len(fields) >= 6:
+                records.append(fields[:9])
+            elif fields:
+                break  # like the simulator, stop at the first incomplete record
+    return workload(records)
+
+
+def _view(pointer, count, dtype, owner):
+    """Array over a buffer of the result, keeping the result alive while the array is"""
+    if count == 0 or not pointer:
+        return np.zeros(0, dtype=dtype)
+    buffer = (ctypes.c_char * (count * dtype.itemsize)).from_address(pointer)
+    buffer._owner = owner
+    return np.frombuffer(buffer, dtype=dtype)
+
+
+class _Owner:
+    """Frees the result once neither the Result nor any of its arrays use it"""
+
+    def __init__(self, result):
+        weakref.finalize(self, _lib.scheduler_result_free, result)
+
+
+class Result:
+    """Result of a simulation
+
+    processes: PROCESS_METRICS array, in order of termination
+    events: TRACE_EVENT array (empty unless asked for)
+    makespan, dispatches, context_switches, migrations, idle_time: run summary
+    """
+
+    def __init__(self, result):
+        owner = _Owner(result)
+        r = result.contents
+        self.processes = _view(r.processes, r.num_processes, PROCESS_METRICS, owner)
+        self.events = _view(r.events, r.num_events, TRACE_EVENT, owner)
+        self.makespan = r.makespan
+        self.dispatches = r.dispatches
+        self.context_switches = r.context_switches
+        self.migrations = r.migrations
+        self.idle_time = r.idle_time
+
+
+def simulate(workload, policy, trace=False):
+    """Simulates a workload (WORKLOAD array) with fcfs, sjf, srtf, gang, rm or edf"""
+    init()
+    sort = _lib.scheduler_policy(policy.encode())
+    if sort < 0:
+        raise ValueError("unknown policy %s" % policy)
+    w = np.ascontiguousarray(workload, dtype=WORKLOAD)
+    return Result(_lib.scheduler_run(w.ctypes.data, len(w), sort, 1 if trace else 0))
+
+
+def compare(workload, policies, trace=False):
+    """Simulates a workload with several policies in parallel, returns policy --> Result"""
+    init()
+    w = np.ascontiguousarray(workload, dtype=WORKLOAD)
+    with ThreadPoolExecutor(max_workers=len(policies)) as pool:
+        results = pool.map(lambda policy: simulate(w, policy, trace), policies)
+        return dict(zip(policies, results))
@@ -0,0 +1,511 @@
+/**
+ * Trace query tool for the Scheduling Simulation
+ *
+ * Authors: Ryan Seys and Osazuwa Omigie
+ *
+ * Prints the transitions of a trace in a time range, or those of one pid, without reading the
+ * whole trace. The trace and its index are mapped into memory, the index is binary searched and
+ * only the chunks of the trace that can hold matching lines are scanned.
+ *
+ * Text traces need the index written with TRACE_INDEX=1 (<trace>.tix). Pid queries read the lines
+ * of the pid straight from their offsets when the trace also has the posting lists written with
+ * TRACE_PID_INDEX=1 (<trace>.pix). Compressed traces
+ * (TRACE_COMPRESS=1, <trace>.gz) use their block index and only decompress the blocks in the
+ * range; they can be queried by time only.
+ *
+ * REPEAT records (FAST_FORWARD=2) are expanded: the lines they stand for that fall in the range
+ * are printed in their place, with their times, while the record itself is not. A compressed
+ * trace whose repeated lines start in the block before the record's prints the record instead.
+ *
+ *     trace_query <trace> <from> <to>
+ *     trace_query <trace> pid <pid> [<from> <to>]
+ *
+ * "make query" builds it.
+ */
+
+#define SCHEDULER_NO_MAIN
+#include "scheduler.c"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <ctype.h>
+
+/**
+ * A file mapped into memory
+ *
+ * data: contents of the file
+ * size: size of the file
+ */
+struct mapped_file {
+    const guint8 * data;
+    gsize size;
+};
+
+/**
+ * An opened trace and its index
+ *
+ * trace, index: the mapped trace and index
+ * compressed: the trace is compressed (the index is its block index)
+ * num_chunks, chunks: the chunks of the trace, in time order
+ * num_pids, pids: the pid directory (none for compressed traces)
+ * pid_chunks, num_pid_chunks: the chunk numbers of the pids
+ * postings: the mapped posting lists (size 0 for none)
+ * num_posting_pids, posting_pids: the directory of the posting lists
+ * posting_data: the posting lists
+ * buffer: the last decompressed block
+ */
+struct trace_query {
+    struct mapped_file trace;
+    struct mapped_file index;
+    gboolean compressed;
+    guint32 num_chunks;
+    const struct trace_block_entry * chunks;
+    guint32 num_pids;
+    const struct trace_pid_entry * pids;
+    const guint32 * pid_chunks;
+    guint64 num_pid_chunks;
+    struct mapped_file postings;
+    guint32 num_posting_pids;
+    const struct trace_pid_entry * posting_pids;
+    const guint8 * posting_data;
+    GByteArray * buffer;
+};
+
+/**
+ * Maps a file into memory, read only
+ * @param  filename name of the file
+ * @param  f        the mapping
+ * @return          TRUE if the file could be mapped
+ */
+gboolean map_file(const char * filename, struct mapped_file * f) {
+  struct stat st;
+  int fd = open(filename, O_RDONLY);
+
+  if(fd < 0) return FALSE;
+  if(fstat(fd, &st) != 0) {
+    close(fd);
+    return FALSE;
+  }
+  f->size = st.st_size;
+  f->data = f->size > 0 ? mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  close(fd);
+  if(f->data == MAP_FAILED) {
+    f->size = 0;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * Unmaps a file
+ * @param f the mapping
+ */
+void unmap_file(struct mapped_file * f) {
+  if(f->size > 0) munmap((void *) f->data, f->size);
+}
+
+/**
+ * Opens the posting lists of a trace if it has them
+ * @param filename name of the trace
+ * @param q        the opened trace
+ */
+void query_open_postings(const char * filename, struct trace_query * q) {
+  char * postings = g_strconcat(filename, ".pix", NULL);
+  gsize header = strlen(TRACE_PID_INDEX_MAGIC) + 2 * sizeof(guint32);
+  guint32 counts[2];
+
+  if(map_file(postings, &q->postings)) {
+    if(q->postings.size >= header && memcmp(q->postings.data, TRACE_PID_INDEX_MAGIC, strlen(TRACE_PID_INDEX_MAGIC)) == 0) {
+      memcpy(counts, q->postings.data + strlen(TRACE_PID_INDEX_MAGIC), sizeof(counts));
+      if((q->postings.size - header) / sizeof(struct trace_pid_entry) >= counts[0]) {
+        q->num_posting_pids = counts[0];
+        q->posting_pids = (const struct trace_pid_entry *) (q->postings.data + header);
+        q->posting_data = (const guint8 *) (q->posting_pids + counts[0]);
+      }
+    }
+    if(q->posting_pids == NULL) {
+      printf("Ignoring the damaged posting lists %s\n", postings);
+      unmap_file(&q->postings);
+      q->postings.size = 0;
+    }
+  }
+  g_free(postings);
+}
+
+/**
+ * Opens a trace and its index, checking that the index fits the trace
+ * @param  filename name of the trace
+ * @param  q        the opened trace
+ * @return          TRUE if the trace and its index could be opened
+ */
+gboolean query_open(const char * filename, struct trace_query * q) {
+  gsize len = strlen(filename), header;
+  char * index;
+  guint32 i, counts[2];
+
+  memset(q, 0, sizeof(*q));
+  q->compressed = len >= 3 && strcmp(filename + len - 3, ".gz") == 0;
+  index = g_strconcat(filename, q->compressed ? ".idx" : ".tix", NULL);
+  if(!map_file(filename, &q->trace) || !map_file(index, &q->index)) {
+    printf("Could not open %s or its index %s\n", filename, index);
+    g_free(index);
+    return FALSE;
+  }
+  g_free(index);
+
+  if(q->compressed) {
+    header = strlen(TRACE_INDEX_MAGIC);
+    if(q->index.size < header || memcmp(q->index.data, TRACE_INDEX_MAGIC, header) != 0) goto corrupt;
+    q->num_chunks = (q->index.size - header) / sizeof(struct trace_block_entry);
+  } else {
+    header = strlen(TRACE_TIME_INDEX_MAGIC) + sizeof(counts);
+    if(q->index.size < header || memcmp(q->index.data, TRACE_TIME_INDEX_MAGIC, strlen(TRACE_TIME_INDEX_MAGIC)) != 0) goto corrupt;
+    memcpy(counts, q->index.data + strlen(TRACE_TIME_INDEX_MAGIC), sizeof(counts));
+    q->num_chunks = counts[0];
+    q->num_pids = counts[1];
+    if((q->index.size - header) / sizeof(struct trace_block_entry) < q->num_chunks) goto corrupt;
+    q->pids = (const struct trace_pid_entry *) (q->index.data + header + (gsize) q->num_chunks * sizeof(struct trace_block_entry));
+    if(((const guint8 *) q->pids - q->index.data) + (gsize) q->num_pids * sizeof(struct trace_pid_entry) > q->index.size) goto corrupt;
+    q->pid_chunks = (const guint32 *) (q->pids + q->num_pids);
+    q->num_pid_chunks = (q->index.size - ((const guint8 *) q->pid_chunks - q->index.data)) / sizeof(guint32);
+  }
+  q->chunks = (const struct trace_block_entry *) (q->index.data + header);
+  for(i = 0; i < q->num_chunks; i++) {
+    if(q->chunks[i].offset > q->trace.size || q->chunks[i].size > q->trace.size - q->chunks[i].offset) goto corrupt;
+  }
+  q->buffer = g_byte_array_new();
+  if(!q->compressed) query_open_postings(filename, q);
+  return TRUE;
+
+corrupt:
+  printf("The index of %s is damaged or does not belong to it\n", filename);
+  unmap_file(&q->trace);
+  unmap_file(&q->index);
+  return FALSE;
+}
+
+/**
+ * Closes a trace
+ * @param q the opened trace
+ */
+void query_close(struct trace_query * q) {
+  unmap_file(&q->trace);
+  unmap_file(&q->index);
+  unmap_file(&q->postings);
+  g_byte_array_free(q->buffer, TRUE);
+}
+
+/**
+ * Gets the text of a chunk of a trace, decompressing it if needed
+ * @param  q      the opened trace
+ * @param  i      number of the chunk
+ * @param  length length of the text
+ * @return        the text (not NUL terminated), NULL if the chunk can not be decompressed
+ */
+const char * query_chunk(struct trace_query * q, guint32 i, gsize * length) {
+  const struct trace_block_entry * e = &q->chunks[i];
+  z_stream z;
+  int ret;
+
+  if(!q->compressed) {
+    *length = e->size;
+    return (const char *) q->trace.data + e->offset;
+  }
+  memset(&z, 0, sizeof(z));
+  if(inflateInit2(&z, 15 + 16) != Z_OK) return NULL; //15 + 16: gzip wrapper
+  g_byte_array_set_size(q->buffer, e->length);
+  z.next_in = (Bytef *) q->trace.data + e->offset;
+  z.avail_in = e->size;
+  z.next_out = q->buffer->data;
+  z.avail_out = e->length;
+  ret = inflate(&z, Z_FINISH);
+  *length = z.total_out;
+  inflateEnd(&z);
+  return ret == Z_STREAM_END ? (const char *) q->buffer->data : NULL;
+}
+
+/**
+ * Reads the time and pid of a trace line
+ * @param  line start of the line
+ * @param  end  end of the text
+ * @param  time time of the transition
+ * @param  pid  process id
+ * @return      start of the next line, *time is -1 for lines that are not transitions
+ */
+const char * query_line(const char * line, const char * end, int * time, int * pid) {
+  const char * next = memchr(line, '\n', end - line);
+  int * field = time;
+
+  *time = *pid = -1;
+  next = next == NULL ? end : next + 1;
+  if(line == next || !isdigit((unsigned char) *line)) return next;
+  for(*field = 0; line < next; line++) {
+    if(isdigit((unsigned char) *line)) {
+      *field = *field * 10 + (*line - '0');
+    } else if(*line == '\t' && field == time) {
+      field = pid;
+      *field = 0;
+    } else {
+      break;
+    }
+  }
+  return next;
+}
+
+/**
+ * Reads a REPEAT record
+ * @param  line   start of the line
+ * @param  next   start of the next line
+ * @param  lines  number of lines before the record that repeat
+ * @param  times  number of repetitions
+ * @param  period time between the repetitions
+ * @return        TRUE if the line is a REPEAT record
+ */
+gboolean query_repeat(const char * line, const char * next, int * lines, int * times, int * period) {
+  char buffer[MAX_LINE];
+  const char * c;
+  int tabs = 0;
+
+  for(c = line; c < next && tabs < 2; c++) tabs += *c == '\t';
+  if(next - c < 6 || memcmp(c, "REPEAT", 6) != 0) return FALSE;
+  memcpy(buffer, line, MIN((gsize) (next - line), sizeof(buffer) - 1));
+  buffer[MIN((gsize) (next - line), sizeof(buffer) - 1)] = '\0';
+  return sscanf(buffer, "%*d\t%*d\tREPEAT\t\t%d lines %d more times every %d", lines, times, period) == 3
+    && *lines > 0 && *times > 0 && *period > 0;
+}
+
+/**
+ * Prints the transitions a REPEAT record stands for in a time range, and of a pid if given
+ * @param  text   start of the text before the record
+ * @param  line   the record
+ * @param  lines  number of lines before the record that repeat
+ * @param  times  number of repetitions
+ * @param  period time between the repetitions
+ * @param  from   start of the range
+ * @param  to     end of the range
+ * @param  pid    only print this pid (-1 for all)
+ * @return        number of lines printed, -1 if the lines that repeat are not all in the text
+ */
+int query_expand(const char * text, const char * line, int lines, int times, int period, int from, int to, int pid) {
+  const char * start = line, * cycle, * next, * rest;
+  gint64 k, first_k, last_k, t;
+  int i, time, p, first = -1, last = -1, count = 0;
+
+  for(i = 0; i < lines; i++) { //back to the first line that repeats
+    if(start == text) return -1;
+    for(start--; start > text && start[-1] != '\n'; start--);
+  }
+  for(cycle = start; cycle < line; cycle = next) {
+    next = query_line(cycle, line, &time, &p);
+    if(time < 0) return -1;
+    if(first < 0) first = time;
+    last = time;
+  }
+  //only the repetitions overlapping the range
+  first_k = from - last <= period ? 1 : ((gint64) from - last + period - 1) / period;
+  last_k = MIN(times, ((gint64) to - first) / period);
+  for(k = first_k; k <= last_k; k++) {
+    for(cycle = start; cycle < line; cycle = next) {
+      next = query_line(cycle, line, &time, &p);
+      t = time + k * period;
+      if(t >= from && t <= to && (pid < 0 || p == pid)) {
+        rest = memchr(cycle, '\t', next - cycle); //the line but for its time
+        printf("%d", (int) t);
+        fwrite(rest, 1, next - rest, stdout);
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+/**
+ * Prints the lines of a chunk in a time range, and of a pid if given
+ * @param  q    the opened trace
+ * @param  i    number of the chunk
+ * @param  from start of the range
+ * @param  to   end of the range
+ * @param  pid  only print this pid (-1 for all)
+ * @return      number of lines printed, -1 if the chunk can not be read
+ */
+int query_print(struct trace_query * q, guint32 i, int from, int to, int pid) {
+  const char * text, * line, * next, * end;
+  gsize length;
+  int time, p, n, lines, times, period, count = 0;
+
+  if((text = query_chunk(q, i, &length)) == NULL) return -1;
+  end = text + length;
+  for(line = text; line < end; line = next) {
+    next = query_line(line, end, &time, &p);
+    if(time > to) break;
+    if(time >= 0 && query_repeat(line, next, &lines, &times, &period)) {
+      //the lines that repeat come right before the record, in the chunk before for a long cycle
+      n = query_expand(q->compressed ? text : (const char *) q->trace.data, line, lines, times, period, from, to, pid);
+      if(n < 0 && (pid < 0 || p == pid)) {
+        fwrite(line, 1, next - line, stdout);
+        n = 1;
+      }
+      count += MAX(n, 0);
+    }
+    else if(time >= 0 && time >= from && (pid < 0 || p == pid)) {
+      fwrite(line, 1, next - line, stdout);
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * Prints the transitions of a trace in a time range
+ * @param  q    the opened trace
+ * @param  from start of the range
+ * @param  to   end of the range
+ * @return      number of lines printed, -1 on a damaged chunk
+ */
+int query_time(struct trace_query * q, int from, int to) {
+  guint32 lo = 0, hi = q->num_chunks, mid;
+  int n, count = 0;
+
+  //first chunk that ends at or after the start of the range
+  while(lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if(q->chunks[mid].last_time < from) lo = mid + 1;
+    else hi = mid;
+  }
+  for(; lo < q->num_chunks && q->chunks[lo].first_time <= to; lo++) {
+    if((n = query_print(q, lo, from, to, -1)) < 0) return -1;
+    count += n;
+  }
+  return count;
+}
+
+/**
+ * Finds a pid in a pid directory
+ * @param  pids the directory, sorted by pid
+ * @param  n    number of entries
+ * @param  pid  process id
+ * @return      the entry of the pid, NULL if it is not there
+ */
+const struct trace_pid_entry * query_find_pid(const struct trace_pid_entry * pids, guint32 n, int pid) {
+  guint32 lo = 0, hi = n, mid;
+
+  while(lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if(pids[mid].pid < pid) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo < n && pids[lo].pid == pid ? &pids[lo] : NULL;
+}
+
+/**
+ * Reads a varint
+ * @param  p   start of the varint
+ * @param  end end of the data
+ * @param  v   the number
+ * @return     position after the varint, NULL if it runs past the end
+ */
+const guint8 * varint_read(const guint8 * p, const guint8 * end, guint64 * v) {
+  int shift;
+
+  *v = 0;
+  for(shift = 0; p < end && shift < 64; shift += 7) {
+    *v |= (guint64) (*p & 0x7f) << shift;
+    if(!(*p++ & 0x80)) return p;
+  }
+  return NULL;
+}
+
+/**
+ * Prints the transitions of a pid in a time range from its posting list
+ * @param  q    the opened trace
+ * @param  e    directory entry of the pid
+ * @param  from start of the range
+ * @param  to   end of the range
+ * @return      number of lines printed, -1 if the posting list does not fit the trace
+ */
+int query_postings(struct trace_query * q, const struct trace_pid_entry * e, int from, int to) {
+  const guint8 * p, * end = q->postings.data + q->postings.size;
+  const char * line, * next, * text_end = (const char *) q->trace.data + q->trace.size;
+  guint64 offset = 0, delta;
+  int time, pid, n, lines, times, period, count = 0;
+  guint32 i;
+
+  if(e->position > (gsize) (end - q->posting_data)) return -1;
+  p = q->posting_data + e->position;
+  for(i = 0; i < e->count; i++) {
+    if((p = varint_read(p, end, &delta)) == NULL) return -1;
+    offset += delta;
+    if(offset >= q->trace.size) return -1;
+    line = (const char *) q->trace.data + offset;
+    next = query_line(line, text_end, &time, &pid);
+    if(time > to) break;
+    if(time >= 0 && query_repeat(line, next, &lines, &times, &period)) { //may stand for the lines of other pids too
+      if((n = query_expand((const char *) q->trace.data, line, lines, times, period, from, to, e->pid)) < 0) return -1;
+      count += n;
+    }
+    else if(pid != e->pid) return -1;
+    else if(time >= from) {
+      fwrite(line, 1, next - line, stdout);
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * Prints the transitions of a pid in a time range, from its posting list if the trace has them
+ * and else from the chunks of the index the pid appears in
+ * @param  q    the opened trace
+ * @param  pid  process id
+ * @param  from start of the range
+ * @param  to   end of the range
+ * @return      number of lines printed, -1 on a damaged chunk or index
+ */
+int query_pid(struct trace_query * q, int pid, int from, int to) {
+  const struct trace_pid_entry * e;
+  guint32 i, c;
+  int n, count = 0;
+
+  if(q->posting_pids != NULL) {
+    e = query_find_pid(q->posting_pids, q->num_posting_pids, pid);
+    return e == NULL ? 0 : query_postings(q, e, from, to);
+  }
+  if((e = query_find_pid(q->pids, q->num_pids, pid)) == NULL) return 0;
+  if(e->position > q->num_pid_chunks || e->count > q->num_pid_chunks - e->position) return -1;
+  for(i = 0; i < e->count; i++) {
+    c = q->pid_chunks[e->position + i];
+    if(c >= q->num_chunks) return -1;
+    if(q->chunks[c].last_time < from) continue;
+    if(q->chunks[c].first_time > to) break;
+    if((n = query_print(q, c, from, to, pid)) < 0) return -1;
+    count += n;
+  }
+  return count;
+}
+
+int main(int argc, char ** argv) {
+  struct trace_query q;
+  int count;
+
+  if((argc == 4 || argc == 6) && strcmp(argv[2], "pid") == 0) {
+    if(!query_open(argv[1], &q)) return 1;
+    if(q.compressed) {
+      printf("Compressed traces have no pid index, query them by time\n");
+      query_close(&q);
+      return 1;
+    }
+    count = query_pid(&q, atoi(argv[3]), argc == 6 ? atoi(argv[4]) : 0, argc == 6 ? atoi(argv[5]) : INT_MAX);
+  } else if(argc == 4) {
+    if(!query_open(argv[1], &q)) return 1;
+    count = query_time(&q, atoi(argv[2]), atoi(argv[3]));
+  } else {
+    printf("Usage: %s <trace> <from> <to>\n       %s <trace> pid <pid> [<from> <to>]\n", argv[0], argv[0]);
+    return 1;
+  }
+  query_close(&q);
+  if(count < 0) {
+    printf("The trace or its index is damaged\n");
+    return 1;
+  }
+  return 0;
+}